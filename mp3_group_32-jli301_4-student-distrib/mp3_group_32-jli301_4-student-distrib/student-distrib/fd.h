@@ -0,0 +1,28 @@
+#ifndef _FD_H
+#define _FD_H
+
+#ifndef ASM
+
+#include "types.h"
+
+typedef struct fd fd_t;
+
+// struct for a file_operation table, the driver gets the open file's entry straight from the syscall
+typedef struct file_operations {
+    int32_t (*open)(const uint8_t* file_name);
+    int32_t (*read)(fd_t* file, void* buf, int32_t nbytes);
+    int32_t (*write)(fd_t* file, const void* buf, int32_t nbytes);
+    int32_t (*close)(fd_t* file);
+} file_operations_t;
+
+// struct for a file descriptor table
+struct fd {
+    file_operations_t* file_ops_table_ptr;
+    uint32_t inode;
+    uint32_t file_position;
+    uint32_t flags;
+};
+
+#endif
+
+#endif /* _FD_H */
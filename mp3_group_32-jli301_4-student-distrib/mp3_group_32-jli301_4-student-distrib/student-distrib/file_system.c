@@ -1,25 +1,104 @@
 #include "file_system.h"
 
+// name -> dentry index, built once in file_system_init
+static int8_t dir_hash_head[DIR_HASH_SIZE];  // first dentry index in each bucket
+static int8_t dir_hash_next[DIR_ENTRIES];    // next dentry index in the same bucket
+static uint8_t dir_name_len[DIR_ENTRIES];    // precomputed length of each file name
+
+// per-inode run cache, built the first time an inode is used and dropped on remount
+#define EXTENTS_UNBUILT 0
+#define EXTENTS_BUILT   1
+#define EXTENTS_NONE    2   // pool was full or the inode is corrupt, read block by block
+
+static extent_t extent_pool[MAX_EXTENTS];
+static uint32_t extent_pool_used;
+static uint32_t extent_first[MAX_INODES];    // index of the inode's first run in extent_pool
+static uint32_t extent_count[MAX_INODES];
+static uint8_t extent_state[MAX_INODES];
+
+/*
+ * dir_name_length
+ *   DESCRIPTION: Length of a file name, stopping at the first '\0' or after MAX_NAME_LENGTH + 1 bytes
+ *   INPUTS: name - file name, not necessarily null terminated
+ *   OUTPUTS: none
+ *   RETURN VALUE: length of name, MAX_NAME_LENGTH + 1 if it is too long
+ *   SIDE EFFECTS: none
+ */
+static uint32_t dir_name_length(const uint8_t* name){
+    uint32_t len = 0;
+    while(len <= MAX_NAME_LENGTH && name[len] != '\0'){
+        len++;
+    }
+    return len;
+}
+
+/*
+ * dir_name_hash
+ *   DESCRIPTION: FNV-1a hash of a file name, folded into a bucket index
+ *   INPUTS: name - file name, len - number of bytes to hash
+ *   OUTPUTS: none
+ *   RETURN VALUE: bucket index in dir_hash_head
+ *   SIDE EFFECTS: none
+ */
+static uint32_t dir_name_hash(const uint8_t* name, uint32_t len){
+    uint32_t hash = 2166136261U;    // FNV offset basis
+    uint32_t i;
+    for(i = 0; i < len; i++){
+        hash ^= name[i];
+        hash *= 16777619U;          // FNV prime
+    }
+    return (hash ^ (hash >> 16)) & (DIR_HASH_SIZE - 1);
+}
+
 /*
  * file_system_init
  *   DESCRIPTION: Initializes file_system
  *   INPUTS: uint32_t start - starting address of boot block
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Sets boot block address, start of inodes address, and start of data blocks address
+ *   SIDE EFFECTS: Sets boot block address, start of inodes address, and start of data blocks address.
+ *                 Builds the hashed name index over the directory entries.
  */
 void file_system_init(uint32_t start){
+    int i;
+    uint32_t bucket;
+
     boot_block = (boot_block_t*) start;
     inode_start = (inode_t*)(boot_block+1);
     db_start = (uint8_t*)(inode_start + boot_block->inode_count);
+
+    // (re)mounting drops every cached run
+    extent_pool_used = 0;
+    for(i = 0; i < MAX_INODES; i++){
+        extent_state[i] = EXTENTS_UNBUILT;
+    }
+
+    for(i = 0; i < DIR_HASH_SIZE; i++){
+        dir_hash_head[i] = DIR_HASH_END;
+    }
+
+    // insert entries back to front so each chain is in directory order
+    for(i = DIR_ENTRIES - 1; i >= 0; i--){
+        dir_hash_next[i] = DIR_HASH_END;
+        dir_name_len[i] = dir_name_length(boot_block->dir_entries[i].file_name);
+        if(dir_name_len[i] == 0){ // unused entry
+            continue;
+        }
+        if(dir_name_len[i] > MAX_NAME_LENGTH){ // name fills all 32 bytes with no '\0'
+            dir_name_len[i] = MAX_NAME_LENGTH;
+        }
+        bucket = dir_name_hash(boot_block->dir_entries[i].file_name, dir_name_len[i]);
+        dir_hash_next[i] = dir_hash_head[bucket];
+        dir_hash_head[bucket] = i;
+    }
 }
 
 /*
  * read_dentry_by_name
- *   DESCRIPTION: Looks through directory entries and finds by name
+ *   DESCRIPTION: Looks up a directory entry by name through the hashed name index
  *   INPUTS: fname - name of file, dentry - empty dentry 
  *   OUTPUTS: none
- *   RETURN VALUE: none
+ *   RETURN VALUE: 0 on success, -1 if the name is invalid or not found
  *   SIDE EFFECTS: Puts found dentry into the passed in dentry
  */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
@@ -31,35 +110,22 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
     }
 
     int i;
-    uint32_t index;
-    uint32_t len = strlen((int8_t*)fname); // getting length of inputted fname
+    uint32_t len = dir_name_length(fname); // getting length of inputted fname
 
     // returns -1 for invalid name
     if(len > MAX_NAME_LENGTH || len == 0){
         return -1;
     }
 
-    // iterate across the file directory
-    for(i = 0; i < DIR_ENTRIES; i++){
-        if(strlen((int8_t*)boot_block->dir_entries[i].file_name) > len){
-            len = strlen((int8_t*)boot_block->dir_entries[i].file_name); // update len if file name in directory is longer
-        }   
-        if(len > MAX_NAME_LENGTH){ // if len is greater than 32, set it to 32
-            len = MAX_NAME_LENGTH;
-        }
-        
-        // if current location in directory matches fname, set index and break
-        if(strncmp((int8_t*)boot_block->dir_entries[i].file_name, (int8_t*)fname, len) == 0){
-            index = i;
+    // walk the bucket chain, names only match if their lengths match
+    for(i = dir_hash_head[dir_name_hash(fname, len)]; i != DIR_HASH_END; i = dir_hash_next[i]){
+        if(dir_name_len[i] == len && strncmp((int8_t*)boot_block->dir_entries[i].file_name, (int8_t*)fname, len) == 0){
             *dentry = boot_block->dir_entries[i];
-            break;
-        }else if(i == DIR_ENTRIES - 1){
-            return -1;
+            return 0;
         }
     }
-    
 
-    return 0;
+    return -1;
     
 }
 
@@ -95,6 +161,98 @@ int32_t get_inode_length(uint32_t inode){
     return inode_start[inode].b_length;
 }
 
+/*
+ * build_extents
+ *   DESCRIPTION: Walks an inode's data block list once and records its runs of consecutive blocks
+ *   INPUTS: inode - index of inode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Appends runs to extent_pool and sets the inode's extent_state
+ */
+static void build_extents(uint32_t inode){
+    uint32_t nth, block;
+    uint32_t num_blocks = (inode_start[inode].b_length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t first = extent_pool_used;
+    uint32_t used = extent_pool_used;
+    extent_t* run = NULL;
+
+    if(num_blocks > DATA_BLOCKS){ // length does not fit in one inode
+        extent_state[inode] = EXTENTS_NONE;
+        return;
+    }
+
+    for(nth = 0; nth < num_blocks; nth++){
+        block = inode_start[inode].data_blocks[nth];
+        if(block >= boot_block->data_count){ // leave bad blocks to the block by block path
+            extent_state[inode] = EXTENTS_NONE;
+            return;
+        }
+        if(run != NULL && run->physical + run->length == block){ // extends the current run
+            run->length++;
+            continue;
+        }
+        if(used == MAX_EXTENTS){
+            extent_state[inode] = EXTENTS_NONE;
+            return;
+        }
+        run = &extent_pool[used++];
+        run->logical = nth;
+        run->physical = block;
+        run->length = 1;
+    }
+
+    extent_pool_used = used;
+    extent_first[inode] = first;
+    extent_count[inode] = used - first;
+    extent_state[inode] = EXTENTS_BUILT;
+}
+
+/*
+ * inode_extents
+ *   DESCRIPTION: Gets the run list of an inode, building it on first use
+ *   INPUTS: inode - index of inode, extents - filled with the inode's first run
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of runs, -1 if the inode has no run list
+ *   SIDE EFFECTS: May build the inode's runs
+ */
+int32_t inode_extents(uint32_t inode, extent_t** extents){
+    if(inode > MAX_INODES - 1 || extents == NULL){
+        return -1;
+    }
+    if(extent_state[inode] == EXTENTS_UNBUILT){
+        build_extents(inode);
+    }
+    if(extent_state[inode] != EXTENTS_BUILT){
+        return -1;
+    }
+    *extents = &extent_pool[extent_first[inode]];
+    return extent_count[inode];
+}
+
+/*
+ * find_extent
+ *   DESCRIPTION: Binary search for the run holding a logical block
+ *   INPUTS: extents - runs of one inode, count - number of runs, nth - logical block
+ *   OUTPUTS: none
+ *   RETURN VALUE: index of the run holding nth
+ *   SIDE EFFECTS: none
+ */
+static uint32_t find_extent(extent_t* extents, uint32_t count, uint32_t nth){
+    uint32_t low = 0;
+    uint32_t high = count - 1;
+    uint32_t mid;
+
+    while(low < high){
+        mid = (low + high + 1) / 2;
+        if(extents[mid].logical <= nth){
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
 /*The last routine works much like the read system call, reading up to
 length bytes starting from position offset in the file with inode number inode and returning the number of bytes
 read and placed in the buffer. A return value of 0 thus indicates that the end of the file has been reached.*/
@@ -105,20 +263,20 @@ read and placed in the buffer. A return value of 0 thus indicates that the end o
  *   DESCRIPTION: Copy contents of the file/inode to buf
  *   INPUTS: inode - index of inode, offset - offset in the file to start reading from, length - # of bytes to read
  *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: buf is filled with contents of the certain file and certain position and length within the file
+ *   RETURN VALUE: number of bytes read, 0 at end of file, -1 if the first data block is bad
+ *   SIDE EFFECTS: buf is filled with contents of the certain file and certain position and length within the file.
+ *                 Each run of consecutive data blocks is copied as one span, falling back to one span
+ *                 per block when the inode has no run list.
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
     
-    int inode_length, nth, byte;
+    uint32_t inode_length, nth, byte, span, block;
+    int32_t count, i;
+    extent_t* extents;
     
     int32_t bytes_read = 0;
-    
-    // Calculate which block and where in block based on offset
-    nth = offset / BLOCK_SIZE;
-    byte = offset % BLOCK_SIZE;
 
-    if(inode < 0 || inode > MAX_INODES - 1){ 
+    if(inode > MAX_INODES - 1 || buf == NULL){ 
         return 0;
     }
 
@@ -126,31 +284,55 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
     inode_length = cur_inode->b_length;
 
     // If offset is out of bounds
-    if(offset > inode_length) 
+    if(offset >= inode_length) 
         return 0;
 
-    // First data block
-    uint8_t* current_DB = &(db_start[(cur_inode->data_blocks[nth])*(BLOCK_SIZE)]);
+    // clamp length to what is left in the file
+    if(length > inode_length - offset){
+        length = inode_length - offset;
+    }
 
-    if(length > inode_length) 
-        length = inode_length;
+    // Calculate which block and where in block based on offset
+    nth = offset / BLOCK_SIZE;
+    byte = offset % BLOCK_SIZE;
 
-    if(inode_length - offset < length){
-        length = inode_length - offset;
+    count = inode_extents(inode, &extents);
+    if (count > 0) {
+        // seek to the run holding the first block, then copy whole runs
+        for (i = find_extent(extents, count, nth); bytes_read < length; i++) {
+            span = (extents[i].logical + extents[i].length - nth) * BLOCK_SIZE - byte;
+            if (span > length - bytes_read) {
+                span = length - bytes_read;
+            }
+
+            block = extents[i].physical + (nth - extents[i].logical);
+            memcpy(buf + bytes_read, &db_start[block * BLOCK_SIZE + byte], span);
+            bytes_read += span;
+
+            nth = extents[i].logical + extents[i].length;
+            byte = 0;
+        }
+        return bytes_read;
     }
 
     while (bytes_read < length) {
-        if (byte >= BLOCK_SIZE) {
-            byte = 0;
-            nth++;
-            // update data block
-            current_DB = &(db_start[(cur_inode->data_blocks[nth])*(BLOCK_SIZE)]);
-        } else {
-            memcpy(buf, current_DB + byte, 1);
-            buf++;
-            byte++;
-            bytes_read++;
+        block = cur_inode->data_blocks[nth];
+        if (block >= boot_block->data_count) {  // corrupt inode, data block out of range
+            return (bytes_read > 0) ? bytes_read : -1;  // keep what was already copied
+        }
+
+        // bytes left in this data block, capped by what is left to read
+        span = BLOCK_SIZE - byte;
+        if (span > length - bytes_read) {
+            span = length - bytes_read;
         }
+
+        memcpy(buf + bytes_read, &db_start[block * BLOCK_SIZE + byte], span);
+        bytes_read += span;
+
+        // every block after the first is read from its start
+        byte = 0;
+        nth++;
     }
 
     return bytes_read;
@@ -11,6 +11,9 @@
 #define MAX_INODES 62
 #define BLOCK_SIZE 4096
 #define TOTAL_BYTES (DATA_BLOCKS * BLOCK_SIZE)
+#define DIR_HASH_SIZE 64 // buckets in the name index, power of 2 and more than DIR_ENTRIES
+#define DIR_HASH_END -1  // end of a bucket chain
+#define MAX_EXTENTS DATA_BLOCKS // runs shared by every cached inode, one per data block at most
 
 /*
  * Dentry struct
@@ -46,6 +49,17 @@ typedef struct boot_block {
     dentry_t dir_entries[DIR_ENTRIES];
 } boot_block_t;
 
+/*
+ * Extent struct
+ * one run of consecutive logical blocks that are also consecutive data blocks
+ * logical: first block index in the file, physical: first data block number, length: blocks in the run
+ */
+typedef struct extent {
+    uint32_t logical;
+    uint32_t physical;
+    uint32_t length;
+} extent_t;
+
 boot_block_t* boot_block;
 inode_t* inode_start;
 uint8_t* db_start;
@@ -55,6 +69,7 @@ extern int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 extern int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 extern int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 extern int32_t get_inode_length(uint32_t inode);
+extern int32_t inode_extents(uint32_t inode, extent_t** extents);
 
 #endif
 
@@ -1,7 +1,5 @@
 #include "file_system_driver.h"
 
-int dir_count; // counter to track which directory current process is in
-
 /* int32_t file_open(uint8_t* file_name)
  * Inputs: file_name
  * Return Value: inode number for success, -1 for failure
@@ -17,18 +15,21 @@ int32_t file_open(const uint8_t* file_name){
     if(res == -1) // means either file is invalid or doesn't exist
         return -1;
 
+    extent_t* extents;
+    inode_extents(file_dentry.inode_number, &extents); // build the run cache on first open
+
     return file_dentry.inode_number; // return inode number to be used in system_call
 }
 
-/* int32_t file_write(int32_t fd, const void* buf, int32_t nbytes)
- * Inputs: fd: file descriptor
+/* int32_t file_write(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: file: open file entry
  *         buf: buffer
  *         bytes: bytes to write
  * Return Value: -1
  * Function: write does nothing for read-only system */
-int32_t file_write(int32_t fd, const void* buf, int32_t nbytes){
+int32_t file_write(fd_t* file, const void* buf, int32_t nbytes){
     // null check for parameters
-    if(fd < 0)
+    if(file == NULL)
         return -1;
     if(buf == NULL)
         return -1;
@@ -38,45 +39,35 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes){
     return -1;
 }
 
-/* int32_t file_read(int32_t fd, int32_t count, uint32_t inode, uint32_t offset)
- * Inputs: fd: file descriptor
+/* int32_t file_read(fd_t* file, int32_t count, uint32_t inode, uint32_t offset)
+ * Inputs: file: open file entry
  *         count: number of bytes to read
  *         inode: index node
  *         offset: offset from start of file
  * Return Value: number of bytes read
  * Function: reads contents of file using read_data */
-int32_t file_read(int32_t fd, void* buf, int32_t nbytes){
+int32_t file_read(fd_t* file, void* buf, int32_t nbytes){
     // null check for parameters
-    if(fd < 0)
+    if(file == NULL)
         return -1;
     if(buf == NULL)
         return -1;
     if(nbytes < 0)
         return -1;
 
-    fd_t fd_temp; // temp file descriptor and pcb
-    pcb_t pcb_temp;
-
-    pcb_temp = get_cur_PCB(); // get current pcb
-
-    fd_temp = pcb_temp.file_descriptor[fd]; // get current file descriptor entry
-
     // read data will fill global variable file_buf
-    int bytes_read = read_data(fd_temp.inode, fd_temp.file_position, buf, nbytes);
+    int bytes_read = read_data(file->inode, file->file_position, buf, nbytes);
 
     return bytes_read;
 }
 
-/* int32_t file_close(int32_t fd)
- * Inputs: fd: file descriptor
+/* int32_t file_close(fd_t* file)
+ * Inputs: file: open file entry
  * Return Value: 0 if file_dentry is successfully set to 0 
  * Function: closes a specific file descriptor */
-int32_t file_close(int32_t fd){
+int32_t file_close(fd_t* file){
     // null check for parameters
-    if(fd < 0) 
-        return -1;
-    
-    if(fd == 0 || fd == 1) // can't close stdin or stdout
+    if(file == NULL) 
         return -1;
 
     return 0;
@@ -85,7 +76,7 @@ int32_t file_close(int32_t fd){
 /* int32_t directory_open(uint8_t* file_name)
  * Inputs: file_name
  * Return Value: inode number for success, -1 for failure
- * Function: opens directory entry by calling read_dentry_by_name (also resets dir_count)*/
+ * Function: opens directory entry by calling read_dentry_by_name, sys_open starts the fd's position at the first entry*/
 int32_t directory_open(const uint8_t* file_name){
     if(file_name == NULL){ // null check
         return -1;
@@ -97,34 +88,30 @@ int32_t directory_open(const uint8_t* file_name){
     if(res == -1) // file name was invalid
         return -1;
 
-    dir_count = 0; // reset dir_count for next ls
-
     return dentry_temp.inode_number; // returns the inode number
 }
 
-/* int32_t directory_close(int32_t fd)
- * Inputs: fd: file descriptor
+/* int32_t directory_close(fd_t* file)
+ * Inputs: file: open file entry
  * Return Value: 0 for success, -1 for failure
  * Function: closes directory */
-int32_t directory_close(int32_t fd){
+int32_t directory_close(fd_t* file){
     // null check for parameters
-    if(fd < 0) 
+    if(file == NULL) 
         return -1;
 
-    dir_count = 0; // reset dir_count (not 100% sure this is needed)
-
     return 0;
 }
 
-/* int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes)
- * Inputs: fd: file descriptor
+/* int32_t directory_write(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: file: open file entry
  *         buf: buffer
  *         nbytes: bytes to write
  * Return Value: -1
  * Function: write does nothing for read-only system */
-int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes){
+int32_t directory_write(fd_t* file, const void* buf, int32_t nbytes){
     // null check for parameters
-    if(fd < 0)
+    if(file == NULL)
         return -1;
     if(buf == NULL)
         return -1;
@@ -134,16 +121,17 @@ int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes){
     return -1;
 }
 
-/* int32_t directory_read(int32_t fd, int32_t count, uint32_t inode, uint32_t offset)
- * Inputs: fd: file descriptor 
+/* int32_t directory_read(fd_t* file, int32_t count, uint32_t inode, uint32_t offset)
+ * Inputs: file: open file entry 
  *         count: number of bytes to read
  *         buf: buffer that is filled with a directory name
  *         nbytes: number of bytes to fill in the buffer
  * Return Value: number of bytes read
- * Function: reads contents of directory entry using read_dentry_by_index */
-int32_t directory_read(int32_t fd, void* buf, int32_t nbytes){
+ * Function: reads contents of directory entry using read_dentry_by_index. The fd's file_position is the
+ *           index of the next entry, so every open directory walks the entries on its own */
+int32_t directory_read(fd_t* file, void* buf, int32_t nbytes){
     // sanity null checks for parameters
-     if(fd < 0)
+     if(file == NULL)
         return -1;
     if(nbytes < 0)
         return -1;
@@ -151,7 +139,7 @@ int32_t directory_read(int32_t fd, void* buf, int32_t nbytes){
     int j;
     int byte_count = 0; // counter for number of bytes read
     dentry_t dentry_temp;
-    int res = read_dentry_by_index(dir_count, &dentry_temp); // fill dentry_temp for current file
+    int res = read_dentry_by_index(file->file_position, &dentry_temp); // fill dentry_temp for current file
     if(res != -1 && dentry_temp.file_name[0] != '\0'){ // check to make sure file exists
         for(j = 0; j < nbytes; j++){ // fill in buf
             if(dentry_temp.file_name[j] == '\0') // breaks when reaches end of name
@@ -159,8 +147,8 @@ int32_t directory_read(int32_t fd, void* buf, int32_t nbytes){
             ((uint8_t*)buf)[j] = dentry_temp.file_name[j];
             byte_count++; // keep track of bytes read
         }
+        file->file_position++;      // update current location in directory, past the end stays put
     }
-    dir_count++;                    // update current location in directory
     return byte_count;
 
 }
@@ -0,0 +1,192 @@
+/* frame.c - Bitmap allocator for physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frame.h"
+#include "lib.h"
+
+#define BITS_PER_WORD   32
+#define WORD_FULL       0xFFFFFFFF
+#define BIG_WORDS       (BIG_FRAMES / BITS_PER_WORD)
+#define SMALL_WORDS     (SMALL_FRAMES / BITS_PER_WORD)
+
+// one bit per frame, set while the frame is taken. Everything starts taken until the memory map says otherwise
+typedef struct frame_pool {
+    uint32_t* map;
+    uint32_t words;
+    uint32_t hint;      // word the last allocation came from, searching resumes there
+    uint32_t free;
+} frame_pool_t;
+
+static uint32_t big_map[BIG_WORDS] = { [0 ... BIG_WORDS - 1] = WORD_FULL };
+static uint32_t small_map[SMALL_WORDS] = { [0 ... SMALL_WORDS - 1] = WORD_FULL };
+static frame_pool_t big_pool = { big_map, BIG_WORDS, 0, 0 };
+static frame_pool_t small_pool = { small_map, SMALL_WORDS, 0, 0 };
+
+/* void pool_set(frame_pool_t* pool, uint32_t frame, uint32_t taken)
+ * Inputs: pool: bitmap to change, frame: frame number, taken: 1 to take the frame, 0 to free it
+ * Return Value: void
+ * Function: flips one bit and keeps the free count right, setting a bit to what it already is does nothing */
+static void pool_set(frame_pool_t* pool, uint32_t frame, uint32_t taken) {
+    uint32_t word = frame / BITS_PER_WORD;
+    uint32_t bit = 1 << (frame % BITS_PER_WORD);
+
+    if (taken && !(pool->map[word] & bit)) {
+        pool->map[word] |= bit;
+        pool->free--;
+    } else if (!taken && (pool->map[word] & bit)) {
+        pool->map[word] &= ~bit;
+        pool->free++;
+        if (word < pool->hint) {
+            pool->hint = word;      // keep handing out low frames first
+        }
+    }
+}
+
+/* int32_t pool_alloc(frame_pool_t* pool)
+ * Inputs: pool: bitmap to take a frame from
+ * Return Value: frame number, -1 if the pool is empty
+ * Function: next fit, skips whole full words from the hint on. The hint only moves past words that are full,
+ *           so each word is stepped over once between frees and allocation is O(1) amortized. Interrupts are off
+ *           from the search to the set, so two preempted callers can't find the same free bit */
+static int32_t pool_alloc(frame_pool_t* pool) {
+    uint32_t i, word, bit;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (pool->free == 0) {
+        restore_flags(flags);
+        return -1;
+    }
+    for (i = 0; i < pool->words; i++) {
+        word = (pool->hint + i) % pool->words;
+        if (pool->map[word] != WORD_FULL) {
+            for (bit = 0; bit < BITS_PER_WORD; bit++) {
+                if (!(pool->map[word] & (1 << bit))) {
+                    pool->hint = word;
+                    pool_set(pool, word * BITS_PER_WORD + bit, 1);
+                    restore_flags(flags);
+                    return word * BITS_PER_WORD + bit;
+                }
+            }
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/* void pool_free(frame_pool_t* pool, uint32_t frame)
+ * Inputs: pool: bitmap the frame came from, frame: frame number
+ * Return Value: void
+ * Function: clears the frame's bit with interrupts off, the word update and free count race pool_alloc otherwise */
+static void pool_free(frame_pool_t* pool, uint32_t frame) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pool_set(pool, frame, 0);
+    restore_flags(flags);
+}
+
+/* void frame_add_region(uint32_t base, uint32_t length)
+ * Inputs: base: physical start of a usable region, length: its size in bytes
+ * Return Value: void
+ * Function: frees every frame that lies wholly inside the region. Big frames below FRAME_RESERVED_END
+ *           and small frames outside the kernel page are left taken */
+void frame_add_region(uint32_t base, uint32_t length) {
+    uint32_t end = base + length;
+    uint32_t first, last, frame;
+
+    // frame numbers from the first whole frame up to the frame the region ends in, a region that
+    // wraps past 4GB runs to the top of the address space
+    first = base / BIG_FRAME_SIZE + (base % BIG_FRAME_SIZE != 0);
+    last = (end < base) ? BIG_FRAMES : end / BIG_FRAME_SIZE;
+    for (frame = first; frame < last; frame++) {
+        if (frame >= FRAME_RESERVED_END / BIG_FRAME_SIZE) {
+            pool_set(&big_pool, frame, 0);
+        }
+    }
+
+    first = base / FRAME_SIZE + (base % FRAME_SIZE != 0);
+    last = (end < base) ? WORD_FULL / FRAME_SIZE + 1 : end / FRAME_SIZE;
+    if (first < KERNEL_PAGE_START / FRAME_SIZE) {
+        first = KERNEL_PAGE_START / FRAME_SIZE;
+    }
+    if (last > KERNEL_PAGE_START / FRAME_SIZE + SMALL_FRAMES) {
+        last = KERNEL_PAGE_START / FRAME_SIZE + SMALL_FRAMES;
+    }
+    for (frame = first; frame < last; frame++) {
+        pool_set(&small_pool, frame - KERNEL_PAGE_START / FRAME_SIZE, 0);
+    }
+}
+
+/* void frame_reserve_small(uint32_t start, uint32_t end)
+ * Inputs: start, end: physical range [start, end) that must not be handed out
+ * Return Value: void
+ * Function: takes every 4KB frame of the kernel page that touches the range */
+void frame_reserve_small(uint32_t start, uint32_t end) {
+    uint32_t addr;
+
+    if (start < KERNEL_PAGE_START) {
+        start = KERNEL_PAGE_START;
+    }
+    if (end > KERNEL_PAGE_START + BIG_FRAME_SIZE) {
+        end = KERNEL_PAGE_START + BIG_FRAME_SIZE;
+    }
+    for (addr = start & ~(FRAME_SIZE - 1); addr < end; addr += FRAME_SIZE) {
+        pool_set(&small_pool, (addr - KERNEL_PAGE_START) / FRAME_SIZE, 1);
+    }
+}
+
+/* uint32_t frame_alloc_big(void)
+ * Inputs: void
+ * Return Value: physical address of a free 4MB frame, FRAME_NONE if there is none
+ * Function: takes a 4MB frame for a process's user memory */
+uint32_t frame_alloc_big(void) {
+    int32_t frame = pool_alloc(&big_pool);
+    return (frame < 0) ? FRAME_NONE : (uint32_t)frame * BIG_FRAME_SIZE;
+}
+
+/* void frame_free_big(uint32_t addr)
+ * Inputs: addr: frame returned by frame_alloc_big
+ * Return Value: void
+ * Function: gives the frame back */
+void frame_free_big(uint32_t addr) {
+    if (addr >= FRAME_RESERVED_END) {
+        pool_free(&big_pool, addr / BIG_FRAME_SIZE);
+    }
+}
+
+/* uint32_t frame_alloc_small(void)
+ * Inputs: void
+ * Return Value: physical address of a free 4KB frame in the kernel page, FRAME_NONE if there is none
+ * Function: the kernel page is mapped in every address space, so the frame is usable straight away */
+uint32_t frame_alloc_small(void) {
+    int32_t frame = pool_alloc(&small_pool);
+    return (frame < 0) ? FRAME_NONE : KERNEL_PAGE_START + (uint32_t)frame * FRAME_SIZE;
+}
+
+/* void frame_free_small(uint32_t addr)
+ * Inputs: addr: frame returned by frame_alloc_small
+ * Return Value: void
+ * Function: gives the frame back */
+void frame_free_small(uint32_t addr) {
+    if (addr >= KERNEL_PAGE_START && addr < KERNEL_PAGE_START + BIG_FRAME_SIZE) {
+        pool_free(&small_pool, (addr - KERNEL_PAGE_START) / FRAME_SIZE);
+    }
+}
+
+/* uint32_t frame_free_big_count(void)
+ * Inputs: void
+ * Return Value: number of free 4MB frames
+ * Function: used by tests and to report memory at boot */
+uint32_t frame_free_big_count(void) {
+    return big_pool.free;
+}
+
+/* uint32_t frame_free_small_count(void)
+ * Inputs: void
+ * Return Value: number of free 4KB frames
+ * Function: used by tests */
+uint32_t frame_free_small_count(void) {
+    return small_pool.free;
+}
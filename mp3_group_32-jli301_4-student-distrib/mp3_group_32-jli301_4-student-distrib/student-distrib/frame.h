@@ -0,0 +1,36 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#ifndef ASM
+
+#include "types.h"
+
+#define FRAME_SIZE          0x1000      // small frame, one 4KB page
+#define BIG_FRAME_SIZE      0x400000    // big frame, one 4MB page
+#define BIG_FRAMES          1024        // 4MB frames in the 4GB physical address space
+#define SMALL_FRAMES        1024        // 4KB frames in the kernel's 4MB page
+#define KERNEL_PAGE_START   0x400000    // the kernel's 4MB page, the only place 4KB frames come from
+#define FRAME_RESERVED_END  0x800000    // video memory, the kernel and its module stay out of the big frame pool
+#define FRAME_NONE          0           // returned when no frame is free, frame 0 is never handed out
+
+/* Mark physical memory usable, called for every free region in the multiboot memory map */
+void frame_add_region(uint32_t base, uint32_t length);
+
+/* Take a range out of the 4KB pool, used for the kernel image, its modules and the kernel stacks */
+void frame_reserve_small(uint32_t start, uint32_t end);
+
+/* Allocate and free 4MB frames */
+uint32_t frame_alloc_big(void);
+void frame_free_big(uint32_t addr);
+
+/* Allocate and free 4KB frames inside the kernel page */
+uint32_t frame_alloc_small(void);
+void frame_free_small(uint32_t addr);
+
+/* Free frames left in each pool */
+uint32_t frame_free_big_count(void);
+uint32_t frame_free_small_count(void);
+
+#endif
+
+#endif /* _FRAME_H */
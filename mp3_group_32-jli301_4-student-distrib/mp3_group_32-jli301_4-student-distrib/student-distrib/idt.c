@@ -1,5 +1,7 @@
 #include "idt.h"
 
+int sysenter_enabled = 0; // set once the SYSENTER MSRs point at sysenter_handler
+
 /*
  * initialize_idt()
  *   DESCRIPTION: Initializes IDT
@@ -25,7 +27,8 @@ void initialize_idt(){
         if (i == SYSTEM_CALL_IDT) {idt[i].dpl = 3;} // dpl value of 3 is user level
     }
 
-    // setting Interrupt IDT entries (0x20 - 0x30)
+    // setting Interrupt IDT entries (0x20 - 0x30), interrupt gates so IF is off until iret. The PIT
+    // handler may switch processes, that must never happen inside another IRQ handler before its EOI
     for(i = 0x20; i < 0x30; i++){
         idt[i].seg_selector = KERNEL_CS;
         idt[i].present = 1;
@@ -34,7 +37,7 @@ void initialize_idt(){
         idt[i].size = 1;
         idt[i].reserved1 = 1;
         idt[i].reserved2 = 1;
-        idt[i].reserved3 = 1;
+        idt[i].reserved3 = 0;
         idt[i].reserved4 = 0;
     }
 
@@ -53,7 +56,7 @@ void initialize_idt(){
     SET_IDT_ENTRY(idt[11], Segment_not_present);
     SET_IDT_ENTRY(idt[12], Stack_segment_present);
     SET_IDT_ENTRY(idt[13], General_protection_fault);
-    SET_IDT_ENTRY(idt[14], Page_fault);
+    SET_IDT_ENTRY(idt[14], page_fault_link);
 
     SET_IDT_ENTRY(idt[16], x87_FPU_error);
     SET_IDT_ENTRY(idt[17], Alignment_check);
@@ -68,6 +71,7 @@ void initialize_idt(){
 
     
     // Setting run time parameters for interrupts in IDT table
+    SET_IDT_ENTRY(idt[PIT_IDT], pit_handler_link);
     SET_IDT_ENTRY(idt[RTC_IDT], rtc_handler_link);
     SET_IDT_ENTRY(idt[KEYBOARD_IDT], keyboard_handler_link);
 
@@ -76,3 +80,29 @@ void initialize_idt(){
     SET_IDT_ENTRY(idt[SYSTEM_CALL_IDT], sys_call_handler);
 }
 
+/*
+ * sysenter_init()
+ *   DESCRIPTION: Points the SYSENTER MSRs at sysenter_handler if the cpu has them
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: SYSENTER enters KERNEL_CS with esp = &tss.esp0, SYSEXIT returns to USER_CS/USER_DS.
+ *                 That needs the GDT order KERNEL_CS, KERNEL_DS, USER_CS, USER_DS we already have.
+ */
+void sysenter_init(){
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(1, eax, ebx, ecx, edx);
+    if (!(edx & CPUID_SEP)) {
+        return;
+    }
+    // early Pentium Pros report SEP but don't have it: family 6, model and stepping under 3
+    if (((eax >> 8) & 0xF) == 6 && ((eax >> 4) & 0xF) < 3 && (eax & 0xF) < 3) {
+        return;
+    }
+
+    wrmsr(IA32_SYSENTER_CS, KERNEL_CS);
+    wrmsr(IA32_SYSENTER_ESP, (uint32_t)&tss.esp0);
+    wrmsr(IA32_SYSENTER_EIP, (uint32_t)sysenter_handler);
+    sysenter_enabled = 1;
+}
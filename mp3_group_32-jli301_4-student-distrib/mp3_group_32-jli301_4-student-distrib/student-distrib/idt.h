@@ -10,12 +10,22 @@
 #include "system_call.h"
 
 
+#define PIT_IDT         0x20 // PRIMARY PIC
 #define RTC_IDT         0x28 // secondary pic
 #define KEYBOARD_IDT    0x21 // PRIMARY PIC
 #define SYSTEM_CALL_IDT 0x80 // System Call Handler
 
+#define IA32_SYSENTER_CS    0x174 // MSRs read by SYSENTER
+#define IA32_SYSENTER_ESP   0x175
+#define IA32_SYSENTER_EIP   0x176
+#define CPUID_SEP           0x800 // cpuid 1 edx bit 11, SYSENTER/SYSEXIT present
+
+extern int sysenter_enabled;
+
 extern void initialize_idt();
 
+extern void sysenter_init();
+
 extern void debug();
 
 extern void divide_by_zero();
@@ -44,7 +54,7 @@ extern void Stack_segment_present();
 
 extern void General_protection_fault();
 
-extern void Page_fault();
+extern void Page_fault(uint32_t error);
 
 extern void x87_FPU_error();
 
@@ -158,9 +158,18 @@ void General_protection_fault(){
 /*
  * Page_fault()
  *   DESCRIPTION: Initializes Page Fault exception
- *   SIDE EFFECTS: Will be called when Page Fault exception occurs
+ *   INPUTS: error - error code pushed by the processor
+ *   SIDE EFFECTS: Will be called when Page Fault exception occurs. Returns if the fault
+ *                 was a demand-paged program page that has now been filled in.
  */
-void Page_fault(){
+void Page_fault(uint32_t error){
+    uint32_t addr;
+    asm volatile("movl %%cr2, %0" : "=r"(addr)); // faulting address
+
+    if(demand_page_fault(addr, error) == 0){
+        return;
+    }
+
     //clear();
     printf("Page Fault \n");
     while(1){}
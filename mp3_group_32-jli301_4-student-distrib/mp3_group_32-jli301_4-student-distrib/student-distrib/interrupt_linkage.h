@@ -3,9 +3,15 @@
 
 #include "idt.h"
 
+#define SYS_CALL_MAX    14  // highest system call number in sys_call_table
+
 #ifndef ASM
     extern void keyboard_handler_link();
     extern void rtc_handler_link();
+    extern void pit_handler_link();
+    extern void page_fault_link();
+    extern void sysenter_handler();
+    extern void sysenter_kernel_handler();
 #endif
 
 #endif
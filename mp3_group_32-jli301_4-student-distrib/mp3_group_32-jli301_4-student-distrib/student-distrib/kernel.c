@@ -14,6 +14,8 @@
 #include "rtc.h"
 #include "file_system_driver.h"
 #include "system_call.h"
+#include "pit.h"
+#include "frame.h"
 
 #define RUN_TESTS
 
@@ -21,12 +23,18 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+#define MMAP_USABLE         1           // memory map type of free RAM
+#define MEM_UPPER_START     0x100000    // mem_upper counts KB from 1MB
+
+extern uint8_t _end;                    // end of the kernel's bss, from the linker
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
     uint32_t start_addr;
+    uint32_t kernel_end = (uint32_t)&_end;
 
     /* Clear the screen. */
     clear();
@@ -68,6 +76,9 @@ void entry(unsigned long magic, unsigned long addr) {
                 printf("0x%x ", *((char*)(mod->mod_start+i)));
             }
             printf("\n");
+            if ((unsigned int)mod->mod_end > kernel_end) {
+                kernel_end = (unsigned int)mod->mod_end;
+            }
             mod_count++;
             mod++;
         }
@@ -94,6 +105,7 @@ void entry(unsigned long magic, unsigned long addr) {
         for (mmap = (memory_map_t *)mbi->mmap_addr;
                 (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
                 mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size)))
+        {
             printf("    size = 0x%x, base_addr = 0x%#x%#x\n    type = 0x%x,  length    = 0x%#x%#x\n",
                     (unsigned)mmap->size,
                     (unsigned)mmap->base_addr_high,
@@ -101,8 +113,22 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->type,
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
+            // type 1 is usable RAM, anything that starts above 4GB can't be reached without PAE
+            if (mmap->type == MMAP_USABLE && mmap->base_addr_high == 0) {
+                frame_add_region(mmap->base_addr_low,
+                        mmap->length_high ? -mmap->base_addr_low : mmap->length_low);
+            }
+        }
+    } else if (CHECK_FLAG(mbi->flags, 0)) {
+        // no memory map, everything from 1MB up to mem_upper is RAM
+        frame_add_region(MEM_UPPER_START, (unsigned)mbi->mem_upper * 1024);
     }
 
+    // the kernel, the filesystem module after it and the pcb/kernel stack slots are not free
+    frame_reserve_small(KERNEL_PAGE_START, kernel_end);
+    frame_reserve_small(addr_8MB - OVER_MAX_PROCESSES * size_8kb, addr_8MB);
+    printf("%u free 4MB frames, %u free 4KB frames\n", frame_free_big_count(), frame_free_small_count());
+
     /* Construct an LDT entry in the GDT */
     {
         seg_desc_t the_ldt_desc;
@@ -149,8 +175,9 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize file system
     file_system_init(start_addr);
 
-    // Init the IDT
+    // Init the IDT, and the SYSENTER entry next to int 0x80
     initialize_idt();
+    sysenter_init();
 
     /* Init the PIC */
     i8259_init();
@@ -170,6 +197,18 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize fd
     file_desc_init();
 
+    // Initialize PIT, drives the scheduler
+    pit_init();
+
+    // Initialize terminals, every terminal but the shown one gets its own shell waiting to be scheduled
+    terminals_init();
+    int t;
+    for (t = 0; t < NUM_TERMINALS; t++) {
+        if (t != terminal_shown()) {
+            spawn_program((const uint8_t *)"shell", t);
+        }
+    }
+
     // calling execute on shell
     sys_execute((const uint8_t *)"shell");
 
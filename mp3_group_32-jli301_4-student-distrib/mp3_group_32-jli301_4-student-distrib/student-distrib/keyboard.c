@@ -5,6 +5,7 @@
 #include "keyboard.h"
 #include "lib.h"
 #include "i8259.h"
+#include "terminal_driver.h"
 
 /* Flags for the special character and indexes to tabing and ctrl*/
 int capsChar;
@@ -12,116 +13,90 @@ int shiftChar;
 int ctrlFlag;
 int altFlag;
 int ctrlIndex;
-unsigned char keyboard_buffer[KEY_BUFF_SIZE];
+unsigned char keyboard_buffer[KEY_BUFF_SIZE + 1];   // line being typed, handed to the terminal when enter is pressed
 int keyIndex;
-int enterPress;
 int shiftCount;
 int tabIndex; 
-int capsSpecialFlag;
 int specialFlag;
+static int extendedKey;                                     // last byte was the 0xE0 prefix
+
+/* Line being typed on each terminal that is not shown, swapped with keyboard_buffer on Alt+F1..F3 */
+static unsigned char savedBuffer[NUM_TERMINALS][KEY_BUFF_SIZE + 1];
+static int savedIndex[NUM_TERMINALS];
+static int savedTabIndex[NUM_TERMINALS];
 //unsigned char special[NUM_SPECIAL] = { ESC, BACKSPACE, TAB, ENTER, CTRL, RSHIFT, ALT, CAPSL};
 
 
-/* This scanLetter Matrix is used for shift and capslocks. We itterate though it each keyboard char press to set the capsSpecialFlag
- * to 1 if it is a special character and 0 if it is a letter. The capsSpecialFlag is used for the shift and caps logic
+/* 
+ * keymap[scancode][modifier state] is the character a scan code set 1 make code types, 0 for keys that
+ * don't type anything (modifiers, releases, and the special keys handled in keyboard_input). The state
+ * index is MOD_SHIFT | MOD_CAPS. Caps lock only changes letters, shift changes every key.
  */
-unsigned char scanLetter[LETTER_NUM][2] = { 
-        {'q', 'Q'},
-        {'w', 'W'},
-        {'e', 'E'},
-        {'r', 'R'}, 
-        {'t', 'T'},
-        {'y', 'Y'},
-        {'u', 'U'},
-        {'i', 'I'},
-        {'o', 'O'},
-        {'p', 'P'}, 
-        {'a', 'A'},
-        {'s', 'S'},
-        {'d', 'D'},
-        {'f', 'F'},
-        {'g', 'G'},
-        {'h', 'H'},
-        {'j', 'J'},
-        {'k', 'K'},
-        {'l', 'L'},  
-        {'z', 'Z'},
-        {'x', 'X'},
-        {'c', 'C'},   
-        {'v', 'V'},
-        {'b', 'B'},
-        {'n', 'N'},  
-        {'m', 'M'},
-};
-
+#define LETTER(c)           {(c), (c) - 'a' + 'A', (c) - 'a' + 'A', (c)}
+#define SYMBOL(lo, hi)      {(lo), (hi), (lo), (hi)}
 
+static const uint8_t keymap[KEYMAP_SIZE][MOD_STATES] = {
+        [0x02] = SYMBOL('1', '!'),
+        [0x03] = SYMBOL('2', '@'),
+        [0x04] = SYMBOL('3', '#'),
+        [0x05] = SYMBOL('4', '$'),
+        [0x06] = SYMBOL('5', '%'),
+        [0x07] = SYMBOL('6', '^'),
+        [0x08] = SYMBOL('7', '&'),
+        [0x09] = SYMBOL('8', '*'),
+        [0x0A] = SYMBOL('9', '('),
+        [0x0B] = SYMBOL('0', ')'),
+        [0x0C] = SYMBOL('-', '_'),
+        [0x0D] = SYMBOL('=', '+'),
+        [0x10] = LETTER('q'),
+        [0x11] = LETTER('w'),
+        [0x12] = LETTER('e'),
+        [0x13] = LETTER('r'),
+        [0x14] = LETTER('t'),
+        [0x15] = LETTER('y'),
+        [0x16] = LETTER('u'),
+        [0x17] = LETTER('i'),
+        [0x18] = LETTER('o'),
+        [0x19] = LETTER('p'),
+        [0x1A] = SYMBOL('[', '{'),
+        [0x1B] = SYMBOL(']', '}'),
+        [0x1E] = LETTER('a'),
+        [0x1F] = LETTER('s'),
+        [0x20] = LETTER('d'),
+        [0x21] = LETTER('f'),
+        [0x22] = LETTER('g'),
+        [0x23] = LETTER('h'),
+        [0x24] = LETTER('j'),
+        [0x25] = LETTER('k'),
+        [0x26] = LETTER('l'),
+        [0x27] = SYMBOL(';', ':'),
+        [0x28] = SYMBOL(0x27, '"'),        // 0x27 is the hex code value for ' since it breaks the char
+        [0x29] = SYMBOL('`', '~'),
+        [0x2B] = SYMBOL(92, '|'),           // 92 is the ascii code value for \ since it breaks the char
+        [0x2C] = LETTER('z'),
+        [0x2D] = LETTER('x'),
+        [0x2E] = LETTER('c'),
+        [0x2F] = LETTER('v'),
+        [0x30] = LETTER('b'),
+        [0x31] = LETTER('n'),
+        [0x32] = LETTER('m'),
+        [0x33] = SYMBOL(',', '<'),
+        [0x34] = SYMBOL('.', '>'),
+        [0x35] = SYMBOL('/', '?'),
+        [0x39] = SYMBOL(' ', ' '),
+};
 
 /* 
- * The scanCode 2D array is filled, on the left, with the ASCII character that corresponds to its index. 
- * The index value is equivalent to the universal scancode 1 keyboard. For Checkpoint 1, to get the 
- * lowercase values and numbers, only the scanCode[ASCII Index][0] is in use, the [][1] index is unused. 
+ * Keys sent after an 0xE0 prefix, mapped to the scan code of the key that does the same thing, 0 for
+ * extended keys that are ignored (arrows, home, end, ...).
  */
-
-unsigned char scanCode[SCANCODE_SIZE][2] = {
-        {'0', '0'},
-        {ESC, ESC},
-        {'1', '!'},
-        {'2', '@'},
-        {'3', '#'},
-        {'4', '$'},
-        {'5', '%'},
-        {'6', '^'},
-        {'7', '&'},
-        {'8', '*'},
-        {'9', '('},
-        {'0', ')'},
-        {'-', '_'},
-        {'=', '+'},
-        {BACKSPACE, BACKSPACE},
-        {TAB, TAB}, 
-        {'q', 'Q'},
-        {'w', 'W'},
-        {'e', 'E'},
-        {'r', 'R'}, 
-        {'t', 'T'},
-        {'y', 'Y'},
-        {'u', 'U'},
-        {'i', 'I'},
-        {'o', 'O'},
-        {'p', 'P'},      
-        {'[', '{'}, 
-        {']', '}'},
-        {ENTER, ENTER},
-        {CTRL, CTRL},
-        {'a', 'A'},
-        {'s', 'S'},
-        {'d', 'D'},
-        {'f', 'F'},
-        {'g', 'G'},
-        {'h', 'H'},
-        {'j', 'J'},
-        {'k', 'K'},
-        {'l', 'L'},
-        {';', ':'},
-        {0x27, '"'},  // 0x27 is the hex code value for ' since it breaks the char
-        {'`', '~'},
-        {LSHIFT, LSHIFT},
-        {92, '|'},   // 92 is the ascii code value for \ since it breaks the char
-        {'z', 'Z'},
-        {'x', 'X'},
-        {'c', 'C'},   
-        {'v', 'V'},
-        {'b', 'B'},
-        {'n', 'N'},  
-        {'m', 'M'},
-        {',', '<'},
-        {'.', '>'},   
-        {'/', '?'},
-        {RSHIFT, RSHIFT},
-        {NULL, NULL},  
-        {ALT, ALT},
-        {' ', ' '},  
-        {CAPSL, CAPSL},
+static const uint8_t extended_alias[KEYMAP_SIZE] = {
+        [ENTER_PRESS] = ENTER_PRESS,        // keypad enter
+        [CTRL] = CTRL,                      // right ctrl
+        [CTRL_RELEASE] = CTRL_RELEASE,
+        [ALT] = ALT,                        // right alt
+        [ALT_RELEASE] = ALT_RELEASE,
+        [KEYPAD_SLASH] = KEYPAD_SLASH,      // keypad / types the same as /
 };
 
 /* function     : keyboard_init
@@ -135,12 +110,11 @@ void keyboard_init(void){
     shiftChar = 0;
     keyIndex = 0;
     tabIndex = 0;
-    capsSpecialFlag = 0;
     specialFlag = 0;
+    extendedKey = 0;
     ctrlFlag = 0;
     altFlag = 0;
     ctrlIndex = 0;
-    enterPress = 0;
     keyboard_buffer[KEY_BUFF_SIZE] = ENTER;
     enable_irq(KEYBOARD_IRQ);                               // enables an interrupt to be read on the PIC at the keyboard IRQ 
 }
@@ -152,14 +126,28 @@ void keyboard_init(void){
  * output       : ASCII character to the screen.
  * Description  : This function outputs the corresponding ASCII char onto the screen that was typed by the user on the keyboard.
  *                It reads from the keyboard data port, searches for the corresponding char in the scancode dictionary, then 
- *                prints it to the screen.
+ *                prints it to the screen. Runs through an interrupt gate, so the echo can't be preempted onto another screen.
  * return       : nothing
  */
 /* Handle Keyboard Inputs */
 void keyboard_input(void){  
     int i;
 
-    uint8_t key_pressed = inb(KEYBOARD_DATA_PORT) & 0xFF;   // the data port with 1111 1111 to keep the last 8 bit value. 
+    uint8_t key_pressed;
+    uint8_t c;
+    int prev_screen;
+
+    key_pressed = inb(KEYBOARD_DATA_PORT) & 0xFF;           // the data port with 1111 1111 to keep the last 8 bit value. 
+
+    if (key_pressed == EXTENDED_PREFIX) {                   // the next byte is an extended key
+        extendedKey = 1;
+        send_eoi(KEYBOARD_IRQ);
+        return;
+    }
+    if (extendedKey) {                                      // handle it as the base key it stands for
+        extendedKey = 0;
+        key_pressed = extended_alias[key_pressed];
+    }
 
     // for (i = 0; i < NUM_SPECIAL; i++) { 
     //     if (key_pressed == special[i]) {specialFlag = 1;}
@@ -168,14 +156,21 @@ void keyboard_input(void){
     // j = keyboard_special(key_pressed);
     
     if (key_pressed == NULL){                                                                   // exists if invalid key press
+        send_eoi(KEYBOARD_IRQ);
         return;
     } else if (key_pressed == SHIFT_RIGHT_RELEASE || key_pressed == SHIFT_LEFT_RELEASE){        // changes shift flags upon release of shift key
         shiftChar = 0;
     } else if (key_pressed == CTRL_RELEASE){                                                    // changes ctrl flag upon ctrl key release
         ctrlFlag = 0;
+    } else if (key_pressed == ALT_RELEASE){                                                     // changes alt flag upon alt key release
+        altFlag = 0;
+    } else if (altFlag && key_pressed >= F1 && key_pressed < F1 + NUM_TERMINALS){               // alt+F1..F3 shows another terminal
+        terminal_switch(key_pressed - F1);
     }
 
-    if (keyIndex >= KEY_BUFF_SIZE && !enterPress){                                              // if buffer is full with no enter, allows user to 
+    prev_screen = screen_select(terminal_shown());                                              // typing echoes on the shown terminal
+
+    if (keyIndex >= KEY_BUFF_SIZE){                                                             // if buffer is full with no enter, allows user to 
         if (key_pressed == BACKSPACE) {                                                         // backspace into the buffer and write until 
                 if (tabIndex == keyIndex) {                                                     // buffer is full again or enter is pressed
                     for (i = 0; i < TAB_SIZE; i++) {                                                   // backspace tab check (tab is 4 spaces)
@@ -189,13 +184,12 @@ void keyboard_input(void){
         }
     }
 
-    if ( keyIndex <= KEY_BUFF_SIZE /*&& !enterPress*/) {                                        // checks that the index is within buffer size
+    if ( keyIndex <= KEY_BUFF_SIZE) {                                                           // checks that the index is within buffer size
         if (key_pressed <= CAPSL) {                                                              // check valid key in scancode
-            if (key_pressed == ENTER_PRESS) {                                                          // sets enter flag, writes enter to buffer
-                enterPress = 1;
+            if (key_pressed == ENTER_PRESS) {                                                   // hands the line to the terminal, starts a new one
                 putc('\n');                                                                     // calls putc for enter 
-                keyboard_buffer[keyIndex] = '\n';
-                keyIndex++;
+                line_push(keyboard_buffer, keyIndex);                                           // typed ahead lines wait there for terminal_read
+                keyIndex = 0;
             } else if (key_pressed == ALT){                                                     // sets alt flag
                 // for (i = 0; i < keyIndex; i++ ) { putc(keyboard_buffer[i]); }
                 altFlag = 1;
@@ -227,62 +221,52 @@ void keyboard_input(void){
                 ctrlIndex = keyIndex;
             } else {
 
-                for (i = 0; i < LETTER_NUM; i++){                                                       // iterrates through the letter scan code 
-                    if (scanLetter[i][1] == scanCode[key_pressed][1]){                          
-                        capsSpecialFlag = 0;                                                    // sets cpasSpecialFlag to 1 if not a letter
-                        break;
-                    } 
-                    capsSpecialFlag = 1;
-                }
+                c = keymap[key_pressed][(shiftChar ? MOD_SHIFT : 0) | (capsChar ? MOD_CAPS : 0)];
 
-                if (ctrlFlag && key_pressed == L_KEY && ctrlIndex == keyIndex) {                                     // sets ctrl+l : clears the screen an resets cursor
-                    keyboard_buffer[keyIndex] = scanCode[key_pressed][0];                                           // adds l to buffer, but clears the keyboard buffer after
+                if (ctrlFlag && key_pressed == L_KEY && ctrlIndex == keyIndex) {                                     // sets ctrl+l and ctrl+L : clears the screen an resets cursor
+                    keyboard_buffer[keyIndex] = c;                                                                  // adds l to buffer, but clears the keyboard buffer after
                     clear();
                     resetBuff();                                                                                    // reset buffer and flags
                     ctrlFlag = 0;
                     keyIndex = 0;
-                } else if (ctrlFlag && key_pressed == L_KEY && ctrlIndex == keyIndex && shiftChar) {                 // case: ctrl+shift+l aka ctrl+L
-                    keyboard_buffer[keyIndex] = scanCode[key_pressed][0];
-                    clear();
-                    resetBuff();
-                    ctrlFlag = 0;
-                    keyIndex = 0;
-                } else if (!specialFlag && key_pressed != BACKSPACE){
-                    if (capsChar && shiftChar && !capsSpecialFlag) {                                                // caps logic for shift and unshift combinations for all keyboard keys
-                        keyboard_buffer[keyIndex] = scanCode[key_pressed][0];                                       // does not allow special characters if both caps and shift held
-                        putc(scanCode[key_pressed][0]); 
-                        capsSpecialFlag = 0;
-                    } else if (capsChar && shiftChar && capsSpecialFlag) {                                          // allows for special chars if cpas is on but shift is held down
-                        keyboard_buffer[keyIndex] = scanCode[key_pressed][1];
-                        putc(scanCode[key_pressed][1]);
-                        capsSpecialFlag = 0;
-                    } else if (capsChar && capsSpecialFlag && !shiftChar) {                                         // does not allow special characters if caps but not shift
-                        keyboard_buffer[keyIndex] = scanCode[key_pressed][0];
-                        putc(scanCode[key_pressed][0]);
-                        capsSpecialFlag = 0;
-                    } else if (capsChar || shiftChar) {                                                             // prints upper case on letters
-                        keyboard_buffer[keyIndex] = scanCode[key_pressed][1];
-                        putc(scanCode[key_pressed][1]);
-                    } else {                                                                                        //prints lower case
-                        keyboard_buffer[keyIndex] = scanCode[key_pressed][0];
-                        putc(scanCode[key_pressed][0]);
-                    }
+                } else if (!specialFlag && c != 0){                                                                 // one table lookup covers caps and shift
+                    keyboard_buffer[keyIndex] = c;
+                    putc(c);
                     keyIndex++;
                 }
             }
         }
     }
     
+    screen_select(prev_screen);
+    flush_screen();                                         // show the echo right away
     send_eoi(KEYBOARD_IRQ);                                 // send eoi to the interrupt controller
 }
 
+/* function     : keyboard_switch_line
+ * input        : from - terminal being hidden, to - terminal being shown
+ * output       : nothing
+ * Description  : Keeps the half typed line of the hidden terminal and brings back the shown one's
+ * return       : nothing
+ */
+void keyboard_switch_line(int from, int to){
+    memcpy(savedBuffer[from], keyboard_buffer, keyIndex);
+    savedIndex[from] = keyIndex;
+    savedTabIndex[from] = tabIndex;
+
+    memcpy(keyboard_buffer, savedBuffer[to], savedIndex[to]);
+    keyIndex = savedIndex[to];
+    tabIndex = savedTabIndex[to];
+}
+
+/* function     : resetBuff
+ * input        : nothing
+ * output       : nothing
+ * Description  : Throws away the line being typed. Lines already entered stay in the terminal's line ring
+ * return       : nothing
+ */
 void resetBuff(void){                                       // resets the buffer
-    enterPress = 0;
-    int i;
-    for (i = 0; i < KEY_BUFF_SIZE; i++){                    // fills buffer with 0
-        keyboard_buffer[i] = 0;
-    }
-    keyIndex = 0;                                           // reset keyIndex to 0
+    keyIndex = 0;                                           // reset keyIndex to 0, nothing reads past it
 }
 
 
@@ -14,7 +14,12 @@
 #define KEYBOARD_IRQ    1
 #define KEYBOARD_DATA_PORT   0x60
 
-#define SCANCODE_SIZE       59
+#define KEYMAP_SIZE         256 // one entry per scan code byte
+#define MOD_STATES          4   // shift and caps lock combinations
+#define MOD_SHIFT           1
+#define MOD_CAPS            2
+#define EXTENDED_PREFIX     0xE0
+#define KEYPAD_SLASH        0x35
 #define KEY_BUFF_SIZE       127 // leaving 1 open space for new line '\n'
 #define NUM_SPECIAL         8
 
@@ -33,9 +38,10 @@
 #define SHIFT_LEFT_RELEASE   0xAA
 #define SHIFT_RIGHT_RELEASE   0xB6
 #define CTRL_RELEASE    0x9D
+#define ALT_RELEASE     0xB8
+#define F1              0x3B    // F2 and F3 follow
 #define ENTER_PRESS 0x1C
 #define TAB_SIZE 4
-#define LETTER_NUM 26
 #define L_KEY 0x26
 
 
@@ -44,9 +50,8 @@ extern int shiftChar;
 extern int ctrlFlag;
 extern int altFlag;
 extern int ctrlIndex;
-extern unsigned char keyboard_buffer[KEY_BUFF_SIZE];
+extern unsigned char keyboard_buffer[KEY_BUFF_SIZE + 1];
 extern int keyIndex;
-extern int enterPress;
 extern int tabIndex;
 
 
@@ -60,6 +65,8 @@ int keyboard_special(uint8_t key_pressed);
 // void keyboard_buffer_output(void);
 
 void resetBuff(void);
+/* Swap the line being typed when the shown terminal changes */
+void keyboard_switch_line(int from, int to);
 
 #endif
 
@@ -10,40 +10,167 @@
 #define ATTRIB      0x7
 #define RIGHT_CORNER 2000
 #define END         0xEE
+#define CRTC_ADDR   0x3D4
+#define CRTC_DATA   0x3D5
+#define CURSOR_LOW  0x0F
+#define CURSOR_HIGH 0x0E
+#define ROW_BYTES   (NUM_COLS * 2)
+
+/* Text is drawn into a screen's shadow and copied to its video page by flush_screen, one whole row
+ * for every row in dirty_rows. shadow is a ring of rows, screen row y is shadow row
+ * (top_row + y) % NUM_ROWS, so scrolling only moves top_row. There is one screen per terminal, putc
+ * and friends draw on the selected one. The hardware cursor follows the shown screen and is only
+ * written when it moved. */
+typedef struct screen {
+    int x;                                                                 // cursor position
+    int y;
+    int top_row;                                                           // shadow row shown at the top of the screen
+    volatile uint32_t dirty_rows;                                          // bit y set when screen row y changed
+    int held;                                                              // screen_hold count, rows stay dirty while set
+    uint16_t shadow[NUM_ROWS * NUM_COLS];                                  // char in the low byte, attribute in the high byte
+} screen_t;
+
+static screen_t screens[NUM_TERMINALS];
+static char* screen_video[NUM_TERMINALS] = { (char *)VIDEO, (char *)VIDEO, (char *)VIDEO }; // video memory or the terminal's backing page
+static screen_t* screen = &screens[0];                                     // screen putc draws on
+static int shown_screen = 0;                                               // screen the cursor belongs to
+static volatile int cursor_dirty;
+static uint16_t cursor_pos;                                                // position last written to the CRTC
+
+/* uint16_t* shadow_row(screen_t* s, int y);
+ * Inputs: s = screen, y = screen row
+ * Return Value: start of that row in the shadow ring
+ * Function: maps a screen row to the ring */
+static inline uint16_t* shadow_row(screen_t* s, int y) {
+    return &s->shadow[NUM_COLS * ((s->top_row + y) % NUM_ROWS)];
+}
+
+/* void set_cell(int x, int y, uint8_t c);
+ * Inputs: x, y = screen position, c = character
+ * Return Value: void
+ * Function: draws a character into the selected screen's shadow buffer */
+static inline void set_cell(int x, int y, uint8_t c) {
+    shadow_row(screen, y)[x] = (ATTRIB << 8) | c;
+    screen->dirty_rows |= 1 << y;
+}
+
+/* int screen_select(int t);
+ * Inputs: t = terminal whose screen putc should draw on
+ * Return Value: previously selected terminal
+ * Function: switches the screen used by putc, printf, clear and backspace */
+int screen_select(int t) {
+    int prev = screen - screens;
+    screen = &screens[t];
+    return prev;
+}
+
+/* void screen_set_video(int t, char* video);
+ * Inputs: t = terminal, video = video memory or the terminal's backing page
+ * Return Value: void
+ * Function: sets where flush_screen copies the terminal's rows to */
+void screen_set_video(int t, char* video) {
+    screen_video[t] = video;
+}
 
-static int screen_x;
-static int screen_y;
-static char* video_mem = (char *)VIDEO;
+/* void screen_show(int t);
+ * Inputs: t = terminal now in video memory
+ * Return Value: void
+ * Function: moves the hardware cursor to the shown terminal's cursor on the next flush */
+void screen_show(int t) {
+    shown_screen = t;
+    cursor_pos = ~0;                                                        // force the CRTC write
+    cursor_dirty = 1;
+}
 
+/* void flush_screen(void);
+ * Inputs: void
+ * Return Value: void
+ * Function: copies the rows changed since the last flush of every screen to its video page and moves
+ *           the hardware cursor if it changed. Called at the end of terminal_write, printf and the
+ *           keyboard handler, and on every PIT tick */
+void flush_screen(void) {
+    uint32_t flags;
+    uint32_t rows;
+    uint16_t pos;
+    screen_t* s;
+    int y;
+
+    cli_and_save(flags);
+    for (s = screens; s < screens + NUM_TERMINALS; s++) {
+        if (s->held) {
+            continue;
+        }
+        rows = s->dirty_rows;
+        s->dirty_rows = 0;
+        for (y = 0; rows != 0; y++, rows >>= 1) {
+            if (rows & 1) {
+                memcpy(screen_video[s - screens] + y * ROW_BYTES, shadow_row(s, y), ROW_BYTES);
+            }
+        }
+    }
+
+    s = &screens[shown_screen];
+    pos = s->y * NUM_COLS + s->x;                                           // gets current cursor positon on screen
+    if (cursor_dirty && pos != cursor_pos) {
+        outb(CURSOR_LOW, CRTC_ADDR);                                        // 0x0F is the cursor data and 0x3D4 is the port
+        outb((uint8_t) (pos & 0xFF), CRTC_DATA);                            // outb to ports the cursor positon data
+        outb(CURSOR_HIGH, CRTC_ADDR);                                       // 0x0E is the cursor data and 0x3D4/0x3D5 is the port
+        outb((uint8_t) ((pos >> 8) & 0xFF), CRTC_DATA);
+        cursor_pos = pos;
+    }
+    cursor_dirty = 0;
+    restore_flags(flags);
+}
+
+/* int screen_hold(void);
+ * Inputs: void
+ * Return Value: terminal of the held screen, for screen_release
+ * Function: keeps flush_screen off the selected screen so a batch of writes reaches the VGA in one flush */
+int screen_hold(void) {
+    uint32_t flags;
+    int t;
+
+    cli_and_save(flags);
+    screen->held++;
+    t = screen - screens;
+    restore_flags(flags);
+    return t;
+}
+
+/* void screen_release(int t);
+ * Inputs: t = terminal from screen_hold
+ * Return Value: void
+ * Function: ends a hold and flushes everything drawn during it */
+void screen_release(int t) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    screens[t].held--;
+    restore_flags(flags);
+    flush_screen();
+}
 
 /* void clear(void);
  * Inputs: void
  * Return Value: none
  * Function: Clears video memory */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-    }
+    memset_word(screen->shadow, (ATTRIB << 8) | ' ', NUM_ROWS * NUM_COLS);
+    screen->top_row = 0;
+    screen->dirty_rows = (1 << NUM_ROWS) - 1;
 
-    screen_x = 0;                                                           // resets the cursor to the top left corner when cleared
-    screen_y = 0;
+    screen->x = 0;                                                           // resets the cursor to the top left corner when cleared
+    screen->y = 0;
     updateCursor();
+    flush_screen();
 }
 
 /* void updateCursor(void);
  * Inputs: void
  * Return Value: none
- * Function: sets the cursor position on screen to be the current x and y position */
+ * Function: marks the cursor as moved to the current x and y position, the next flush_screen writes it */
 void updateCursor(void) {
-    uint16_t pos = screen_y * NUM_COLS + screen_x;                          // gets current cursor positon on screen
-
-    outb(0x0F, 0x3D4);                                                      // 0x0F is the cursor data and 0x3D4 is the port
-    outb((uint8_t) (pos & 0xFF), 0x3D5);                                    // outb to ports the cursor positon data
-
-    outb(0x0E, 0x3D4);                                                      // outb to ports the cursor positon data
-    outb((uint8_t) ((pos >> 8) & 0xFF), 0x3D5);                             // 0x0E is the cursor data and 0x3D4/0x3D5 is the port
+    cursor_dirty = 1;
 }
 
 /* Standard printf().
@@ -169,6 +296,7 @@ format_char_switch:
         }
         buf++;
     }
+    flush_screen();
     return (buf - format);
 }
 
@@ -182,6 +310,7 @@ int32_t puts(int8_t* s) {
         putc(s[index]);
         index++;
     }
+    flush_screen();
     return index;
 }
 
@@ -191,50 +320,47 @@ int32_t puts(int8_t* s) {
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
     if (c == '\n' || c == '\r') {                                                    // test case for enter
-        if (screen_y == NUM_ROWS - 1) {                                                     // if enters on last row, will scroll
+        if (screen->y == NUM_ROWS - 1) {                                                     // if enters on last row, will scroll
             scrolling(END);
-            screen_x = 0;
+            screen->x = 0;
         } else {                                                                            // wont scroll enter if not last row
-            screen_y++;
-            screen_y %= NUM_ROWS;
-            screen_x = 0;
+            screen->y++;
+            screen->y %= NUM_ROWS;
+            screen->x = 0;
         }
-    } else if (screen_y == NUM_ROWS - 1 && screen_x == NUM_COLS - 1 ){ // if y = 24 and x = 79     // this test case is for bottom right of screen
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;              // outs character to screen in video memory
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
+    } else if (screen->y == NUM_ROWS - 1 && screen->x == NUM_COLS - 1 ){ // if y = 24 and x = 79     // this test case is for bottom right of screen
+        set_cell(screen->x, screen->y, c);                                                    // outs character to screen in video memory
         scrolling(END);                                                                     // calls scrolling to start new input on new line
-        // screen_y = NUM_ROWS - 1;
-        screen_x = 0;
-        // screen_x++;
-        //screen_x %= NUM_COLS;
-        screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;                           // reset x and y value
-    } else if (screen_x == NUM_COLS - 1 && c == TAB) {                                      // test case for tab at edge of screen
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_y++;
-        screen_x = 0;
-        //screen_x %= NUM_COLS;
-        screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
+        // screen->y = NUM_ROWS - 1;
+        screen->x = 0;
+        // screen->x++;
+        //screen->x %= NUM_COLS;
+        screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;                           // reset x and y value
+    } else if (screen->x == NUM_COLS - 1 && c == TAB) {                                      // test case for tab at edge of screen
+        set_cell(screen->x, screen->y, ' ');
+        screen->y++;
+        screen->x = 0;
+        //screen->x %= NUM_COLS;
+        screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;
 
         int i;
         for (i = 0; i < 3; i++) {                                                           // calls putc 3 times to finish the tab
             putc(' ');
         }
-    } else if (screen_x == NUM_COLS - 1) {                                                  // test case for if at edge of screen
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;              // will print character then set cursor
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;     // to new line
-        screen_y++;
-        screen_x = 0;
-        //screen_x %= NUM_COLS;
-        screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
+    } else if (screen->x == NUM_COLS - 1) {                                                  // test case for if at edge of screen
+        set_cell(screen->x, screen->y, c);                                                    // will print character then set cursor to new line
+        screen->y++;
+        screen->x = 0;
+        //screen->x %= NUM_COLS;
+        screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;
     // } else if (c == '\n' || c == '\r') {                                                    // test case for enter
-    //     if (screen_y == NUM_ROWS - 1) {                                                     // if enters on last row, will scroll
+    //     if (screen->y == NUM_ROWS - 1) {                                                     // if enters on last row, will scroll
     //         scrolling(END);
-    //         screen_x = 0;
+    //         screen->x = 0;
     //     } else {                                                                            // wont scroll enter if not last row
-    //         screen_y++;
-    //         screen_y %= NUM_ROWS;
-    //         screen_x = 0;
+    //         screen->y++;
+    //         screen->y %= NUM_ROWS;
+    //         screen->x = 0;
     //     }
     //     //scrolling(ENTER);
     // // } else if (c == 0x0E) {
@@ -243,11 +369,10 @@ void putc(uint8_t c) {
         int i;
         for (i = 0; i < 4; i++ ) { putc(' ');}
     } else {                                                                                // putc character to screen
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_x++;
-        screen_x %= NUM_COLS;
-        screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
+        set_cell(screen->x, screen->y, c);
+        screen->x++;
+        screen->x %= NUM_COLS;
+        screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;
     }
     updateCursor();                                                                         // updates cursor position
 }
@@ -255,25 +380,14 @@ void putc(uint8_t c) {
 /* void scrolling(uint8_t key);
  * Inputs: uint_8 t = test condition key
  * Return Value: void
- *  Function: Scrolling of video memory on screen  */
+ *  Function: Scrolling of video memory on screen. The old top row becomes the new bottom row,
+ *            the rest of the screen is only copied once, by the next flush_screen */
 void scrolling(uint8_t key){
-    int i, j;
     if (key == END) {                                                                           // checks condition is end of screen
-        for (j = 0; j < NUM_ROWS - 1; j++){                                                     // itterates through rows and coloumns
-            for (i = 0; i < NUM_COLS; i++) {
-                // iterates through all positions on screen in video memory
-                    *(uint8_t *)(video_mem + ((NUM_COLS * (j) + i ) << 1)) =                    // Sets row memory to equal the one after
-                        *(uint8_t *)(video_mem + ((NUM_COLS * (j+1) + i) << 1));
-                    *(uint8_t *)(video_mem + ((NUM_COLS * (j) + i) << 1) + 1) = ATTRIB;
-
-                if (j == NUM_ROWS - 2) {                                                        // checks if at bottom of screen, will clear the bottom line
-                    *(uint8_t *)(video_mem + ((NUM_COLS * (j+1) + i) << 1)) = ' ';
-                    *(uint8_t *)(video_mem + ((NUM_COLS * j + i) << 1) + 1) = ATTRIB;
-                }
-            }
-        }
+        screen->top_row = (screen->top_row + 1) % NUM_ROWS;                                     // every row moves up one
+        memset_word(shadow_row(screen, NUM_ROWS - 1), (ATTRIB << 8) | ' ', NUM_COLS);           // clears the bottom line
+        screen->dirty_rows = (1 << NUM_ROWS) - 1;
     }
-
 }
 
 /* void backspace(void);
@@ -281,38 +395,36 @@ void scrolling(uint8_t key){
  * Return Value: void
  *  Function: backspaces character and removes video memory on screen*/
 void backspace(void) {
-    uint16_t pos = screen_y * NUM_COLS + screen_x;                                          // gets current screen position
-    if (pos == screen_y * NUM_COLS){                                                        // if screen_x = 0 sets y to previous line
-        screen_x = 80;                                                                      // sets x to last column position    
-        screen_y--;
-        if (screen_y < 0) {                                                                 // condition on backspace in top left corner
-            screen_y = 0;                                                                   // doesnt alter video memory if backspace 
-            screen_x = 0;
+    uint16_t pos = screen->y * NUM_COLS + screen->x;                                          // gets current screen position
+    if (pos == screen->y * NUM_COLS){                                                        // if screen->x = 0 sets y to previous line
+        screen->x = 80;                                                                      // sets x to last column position    
+        screen->y--;
+        if (screen->y < 0) {                                                                 // condition on backspace in top left corner
+            screen->y = 0;                                                                   // doesnt alter video memory if backspace 
+            screen->x = 0;
             return;             
         }
-        pos = screen_y * NUM_COLS + screen_x;
+        pos = screen->y * NUM_COLS + screen->x;
         if (pos != 0){                                                                      // if not in top left corner
-            screen_x --;                                                                    // backspaces in video memory, 
-            screen_x %= NUM_COLS;                                                           // removes printed character
-            // screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
+            screen->x --;                                                                    // backspaces in video memory, 
+            screen->x %= NUM_COLS;                                                           // removes printed character
+            // screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;
+            set_cell(screen->x, screen->y, ' ');
         }
     } else { 
-        if (screen_y < 0) {                                                                 // checks that doesnt go past the first row
-            screen_y = 0;
-            screen_x = 0;
+        if (screen->y < 0) {                                                                 // checks that doesnt go past the first row
+            screen->y = 0;
+            screen->x = 0;
             return;
         }
 
-        pos = screen_y * NUM_COLS + screen_x;
+        pos = screen->y * NUM_COLS + screen->x;
 
         if (pos != 0){                                                                      // backsaces in video memory 
-            screen_x --;    
-            screen_x %= NUM_COLS;
-            // screen_y = (screen_y + (screen_x / NUM_COLS)) % NUM_ROWS;
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
+            screen->x --;    
+            screen->x %= NUM_COLS;
+            // screen->y = (screen->y + (screen->x / NUM_COLS)) % NUM_ROWS;
+            set_cell(screen->x, screen->y, ' ');
         }
     }
     updateCursor();                                                                         // updates cursor position 
@@ -609,7 +721,9 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
 void test_interrupts(void) {
     int32_t i;
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        video_mem[i << 1]++;
+        ((uint8_t *)screen->shadow)[i << 1]++;
     }
+    screen->dirty_rows = (1 << NUM_ROWS) - 1;
+    flush_screen();
 }
 
@@ -19,12 +19,20 @@
 #define CAPSL       0x3A
 #define BOTTOM      0xBB
 
+#define NUM_TERMINALS 3                 // one screen per terminal
+
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 void backspace(void);               // backspace funtion 
 void scrolling(uint8_t c);          // scrolling function
 void leftCursor(void);              // top left cursor update function
 void updateCursor(void);            // updates cursor positon on screen
+void flush_screen(void);            // copies changed rows and the cursor to the VGA
+int screen_select(int t);           // screen putc draws on, returns the previous one
+void screen_set_video(int t, char* video); // where a screen's rows are flushed to
+void screen_show(int t);            // screen the hardware cursor follows
+int screen_hold(void);              // hold flushes of the selected screen for a batch of writes
+void screen_release(int t);         // end the hold and flush
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -121,6 +129,25 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Writes a model specific register, high 32 bits are 0 */
+#define wrmsr(msr, value)               \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(value), "d"(0) \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Runs cpuid for a leaf, filling the four output registers */
+#define cpuid(leaf, a, b, c, d)         \
+do {                                    \
+    asm volatile ("cpuid"               \
+            : "=a"(a), "=b"(b), "=c"(c), "=d"(d) \
+            : "a"(leaf)                 \
+    );                                  \
+} while (0)
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
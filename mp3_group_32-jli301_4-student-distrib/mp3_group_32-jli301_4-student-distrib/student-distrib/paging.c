@@ -1,4 +1,7 @@
 #include "paging.h"
+#include "frame.h"
+
+int global_pages_enabled = 0;
 
 /*
  * paging_init
@@ -24,12 +27,14 @@ void paging_init() {
         paging_directory[i].A = 0;
         paging_directory[i].avl = 0;
         paging_directory[i].PS = 1;
-        paging_directory[i].G = 1;
+        paging_directory[i].G = 0;
         paging_directory[i].AVL = 0;
         paging_directory[i].index_31_12 = 0;
     }
 
-     // 0-4mb (marked as present and 4KB pages)
+     // 0-4mb (marked as present and 4KB pages). paging_table only holds the VGA window, the text page and the
+     // terminal backing pages. Everything else down here stays unmapped so NULL and stray low pointers fault,
+     // the multiboot info is only read before paging is turned on
     paging_directory[0].P = 1;
     paging_directory[0].RW = 1;
     paging_directory[0].US = 0;
@@ -38,21 +43,23 @@ void paging_init() {
     paging_directory[0].A = 0;
     paging_directory[0].avl = 0;
     paging_directory[0].PS = 0;
-    paging_directory[0].G = 1;
+    paging_directory[0].G = 0; // ignored when the entry points at a page table, the table's entries say what is global
     paging_directory[0].AVL = 0;
     paging_directory[0].index_31_12 = ((uint32_t)paging_table) >> 12; // paging table address is 20 bits long
 
-    // 4-8mb (marked as present and 4 MB pages)
+    // 4-8mb (marked as present and 4 MB pages). The kernel's text and data, the GDT, IDT and TSS, the boot
+    // stack, the filesystem module and every 4KB frame (page directories, slabs, pipes) live here, so they
+    // all share one TLB entry. Cached, every interrupt and system call runs out of it
     paging_directory[1].P = 1;
     paging_directory[1].RW = 1;
     paging_directory[1].US = 0;
     paging_directory[1].PWT = 0;
-    paging_directory[1].PCD = 1;
+    paging_directory[1].PCD = 0;
     paging_directory[1].A = 0;
     paging_directory[1].avl = 0;
     paging_directory[1].PS = 1;
     paging_directory[1].AVL = 0;
-    paging_directory[1].G = 1;
+    paging_directory[1].G = 1; // the kernel is the same in every process
     paging_directory[1].index_31_12 = 1 << 10; // paging table address is 10 bits long
 
     // holds the physical address where we want to start mapping these pagings to.
@@ -70,7 +77,7 @@ void paging_init() {
         paging_table[i].A = 0;
         paging_table[i].D = 0;
         paging_table[i].PAT = 0;
-        paging_table[i].G = 1;
+        paging_table[i].G = 0;
         paging_table[i].AVL = 0;
         paging_table[i].index_31_12 = 0;
     }
@@ -88,8 +95,192 @@ void paging_init() {
     paging_table[VID_START].AVL = 0;
     paging_table[VID_START].index_31_12 = VID_START;
 
+    // terminal backing pages, 0xB9000 stays unmapped as a guard above video memory
+    for(i = VID_BACKING_START; i < VID_BACKING_START + VID_BACKING_PAGES; i++){
+        paging_table[i].P = 1;
+        paging_table[i].RW = 1;
+        paging_table[i].US = 0;
+        paging_table[i].PWT = 0;
+        paging_table[i].PCD = 0;
+        paging_table[i].A = 0;
+        paging_table[i].D = 0;
+        paging_table[i].PAT = 0;
+        paging_table[i].G = 1;
+        paging_table[i].AVL = 0;
+        paging_table[i].index_31_12 = i;
+    }
+
     // Load paging Directory
     loadPagingDirectory((unsigned int*)paging_directory);
     // Enable paging 
     enablePaging();
+    enable_global_pages();
+}
+
+/*
+ * enable_global_pages
+ *   DESCRIPTION: Turns on CR4.PGE if the cpu has it
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Entries with G set (the kernel's 4MB page, video memory and the terminal backing
+ *                 pages) then survive CR3 reloads. Everything a process maps keeps G clear, so
+ *                 changing one of the global mappings needs tlb_flush_page.
+ */
+void enable_global_pages() {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t cr4;
+
+    cpuid(1, eax, ebx, ecx, edx);
+    if (!(edx & CPUID_PGE)) {
+        return;
+    }
+
+    asm volatile("movl %%cr4, %0" : "=r"(cr4));
+    asm volatile("movl %0, %%cr4" : : "r"(cr4 | CR4_PGE) : "memory");
+    global_pages_enabled = 1;
+}
+
+/*
+ * map_table
+ *   DESCRIPTION: Points the page directory entry holding vaddr at a 4KB page table
+ *   INPUTS: dir - page directory to change, vaddr - any virtual address in the 4MB region,
+ *           table - page table for that region
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Overwrites the page directory entry, user accessible. Caller flushes the TLB if dir is loaded.
+ */
+void map_table(page_dir_t* dir, uint32_t vaddr, paging_table_t* table) {
+    int pageDirIdx = vaddr >> DIR_SHIFT;
+
+    dir[pageDirIdx].P = 1;
+    dir[pageDirIdx].RW = 1;
+    dir[pageDirIdx].US = 1;
+    dir[pageDirIdx].PWT = 0;
+    dir[pageDirIdx].PCD = 0;
+    dir[pageDirIdx].A = 0;
+    dir[pageDirIdx].avl = 0;
+    dir[pageDirIdx].PS = 0;
+    dir[pageDirIdx].G = 0;
+    dir[pageDirIdx].AVL = 0;
+    dir[pageDirIdx].index_31_12 = ((uint32_t)table) >> 12;
+}
+
+/*
+ * map_page
+ *   DESCRIPTION: Maps one user 4KB page in a page table
+ *   INPUTS: table - page table covering vaddr, vaddr - virtual address of the page,
+ *           paddr - physical address of the page, rw - 1 for writable, 0 for read only
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Overwrites the page table entry. Caller flushes the TLB if the page was present.
+ */
+void map_page(paging_table_t* table, uint32_t vaddr, uint32_t paddr, uint32_t rw) {
+    int pageTableIdx = (vaddr >> TABLE_SHIFT) & TABLE_MASK;
+
+    table[pageTableIdx].P = 1;
+    table[pageTableIdx].RW = rw;
+    table[pageTableIdx].US = 1;
+    table[pageTableIdx].PWT = 0;
+    table[pageTableIdx].PCD = 0;
+    table[pageTableIdx].A = 0;
+    table[pageTableIdx].D = 0;
+    table[pageTableIdx].PAT = 0;
+    table[pageTableIdx].G = 0;
+    table[pageTableIdx].AVL = 0;
+    table[pageTableIdx].index_31_12 = paddr >> 12;
+}
+
+/*
+ * map_run
+ *   DESCRIPTION: Maps a run of physically contiguous user 4KB pages in a page table
+ *   INPUTS: table - page table covering the run, vaddr - virtual address of the first page,
+ *           paddr - physical address of the first page, pages - length of the run,
+ *           rw - 1 for writable, 0 for read only
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Overwrites the page table entries, the run must not cross the table's 4MB.
+ *                 Caller flushes the TLB if any page was present.
+ */
+void map_run(paging_table_t* table, uint32_t vaddr, uint32_t paddr, uint32_t pages, uint32_t rw) {
+    uint32_t i;
+
+    for (i = 0; i < pages; i++) {
+        map_page(table, vaddr + i * PAGE_SIZE, paddr + i * PAGE_SIZE, rw);
+    }
+}
+
+/*
+ * unmap_table
+ *   DESCRIPTION: Marks the page directory entry holding vaddr not present
+ *   INPUTS: dir - page directory to change, vaddr - any virtual address in the 4MB region
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Caller flushes the TLB if dir is loaded.
+ */
+void unmap_table(page_dir_t* dir, uint32_t vaddr) {
+    dir[vaddr >> DIR_SHIFT].P = 0;
+}
+
+/*
+ * page_dir_create
+ *   DESCRIPTION: Makes a page directory for a process out of the kernel's
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: new directory in a 4KB frame, NULL if none is free
+ *   SIDE EFFECTS: The first KERNEL_DIR_ENTRIES are copied from paging_directory, so every process
+ *                 shares the kernel's page table and 4MB page. The rest start not present.
+ */
+page_dir_t* page_dir_create() {
+    page_dir_t* dir = (page_dir_t*)frame_alloc_small();
+
+    if (dir == NULL) {
+        return NULL;
+    }
+    memcpy(dir, paging_directory, KERNEL_DIR_ENTRIES * sizeof(page_dir_t));
+    memset(dir + KERNEL_DIR_ENTRIES, 0, (ENTRIES - KERNEL_DIR_ENTRIES) * sizeof(page_dir_t));
+    return dir;
+}
+
+/*
+ * page_dir_free
+ *   DESCRIPTION: Gives a directory from page_dir_create back
+ *   INPUTS: dir - directory that is no longer loaded in CR3
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The page tables it points at belong to their owners and are not freed
+ */
+void page_dir_free(page_dir_t* dir) {
+    frame_free_small((uint32_t)dir);
+}
+
+/*
+ * flush_TLB
+ *   DESCRIPTION: Drops every non-global TLB entry by reloading CR3
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The running process misses again afterwards, so tlb_flush_page is used when
+ *                 only a page or two changed. Global pages stay cached once enable_global_pages ran
+ */
+void flush_TLB() {
+    asm volatile("                 \n\
+            movl    %%cr3, %%eax    \n\
+            movl    %%eax, %%cr3    \n\
+            "
+            :
+            :
+            : "eax", "memory");
+}
+
+/*
+ * tlb_flush_page
+ *   DESCRIPTION: Drops the TLB entry for the page holding vaddr with invlpg
+ *   INPUTS: vaddr - any address in a 4KB page, or in a 4MB page mapped by its directory entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Called after the entry changed. Also drops cached directory entries
+ */
+void tlb_flush_page(uint32_t vaddr) {
+    asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
 }
@@ -6,6 +6,15 @@
 
 #define ENTRIES 1024 // Total number of entries in paging table/directory
 #define VID_START 184 // Start of video memory in paging table
+#define VID_BACKING_START 186 // terminal backing pages, 0xBA000 onwards
+#define VID_BACKING_PAGES 3 // one per terminal
+#define PAGE_SIZE 4096 // size of a 4KB page
+#define DIR_SHIFT 22 // virtual address bits above the page directory index
+#define TABLE_SHIFT 12 // virtual address bits above the page table index
+#define TABLE_MASK 0x3FF // page table index bits after shifting
+#define CPUID_PGE 0x2000 // cpuid 1 edx bit 13, global pages supported
+#define CR4_PGE 0x80 // CR4 bit 7, global pages enabled
+#define KERNEL_DIR_ENTRIES 2 // 0-8MB, the directory entries every process shares
 
 
 // Paging Directory ... Least sign to most ... 4MB and 4KB
@@ -44,7 +53,7 @@ typedef struct paging_dir {
     };
 } page_dir_t;
 
-// array for paging directory (4096 bytes total) 
+// the kernel's paging directory (4096 bytes total), loaded until the first process runs. page_dir_create copies its kernel entries
 page_dir_t paging_directory[ENTRIES] __attribute__((aligned(4096)));
 
 // Page Table
@@ -68,7 +77,18 @@ typedef union paging_table {
 // array for paging table (4096 bytes total)
 paging_table_t paging_table[ENTRIES] __attribute__((aligned(4096)));
 
+extern int global_pages_enabled; // set when CR4.PGE is on
+
 extern void paging_init();
+extern void enable_global_pages();
+extern void map_table(page_dir_t* dir, uint32_t vaddr, paging_table_t* table);
+extern void map_page(paging_table_t* table, uint32_t vaddr, uint32_t paddr, uint32_t rw);
+extern void map_run(paging_table_t* table, uint32_t vaddr, uint32_t paddr, uint32_t pages, uint32_t rw);
+extern void unmap_table(page_dir_t* dir, uint32_t vaddr);
+extern page_dir_t* page_dir_create();
+extern void page_dir_free(page_dir_t* dir);
+extern void flush_TLB();
+extern void tlb_flush_page(uint32_t vaddr);
 
 extern void loadPagingDirectory(unsigned int*);
 extern void enablePaging();
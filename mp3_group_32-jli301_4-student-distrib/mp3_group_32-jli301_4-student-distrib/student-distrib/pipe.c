@@ -0,0 +1,237 @@
+/* pipe.c - Anonymous pipes, a 4KB ring with blocking reads and writes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pipe.h"
+#include "frame.h"
+#include "slab.h"
+#include "lib.h"
+
+static slab_cache_t pipe_cache = SLAB_CACHE_INIT("pipe", sizeof(pipe_t));
+
+static int32_t pipe_bad_call(fd_t* file, void* buf, int32_t nbytes);
+static int32_t pipe_bad_write(fd_t* file, const void* buf, int32_t nbytes);
+
+// each end gets its own table so reading the write end or writing the read end fails like stdin/stdout do
+static file_operations_t pipe_read_ops = {
+    .open = NULL,
+    .read = &pipe_read,
+    .write = &pipe_bad_write,
+    .close = &pipe_read_close};
+
+static file_operations_t pipe_write_ops = {
+    .open = NULL,
+    .read = &pipe_bad_call,
+    .write = &pipe_write,
+    .close = &pipe_write_close};
+
+/* int32_t pipe_bad_call(fd_t* file, void* buf, int32_t nbytes)
+ * Inputs: ignored
+ * Return Value: -1
+ * Function: read on the write end */
+static int32_t pipe_bad_call(fd_t* file, void* buf, int32_t nbytes){
+    return -1;
+}
+
+/* int32_t pipe_bad_write(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: ignored
+ * Return Value: -1
+ * Function: write on the read end */
+static int32_t pipe_bad_write(fd_t* file, const void* buf, int32_t nbytes){
+    return -1;
+}
+
+/* pipe_t* pipe_create(void)
+ * Inputs: none
+ * Return Value: new pipe, NULL if no memory is left
+ * Function: allocates the pipe and its ring frame, both ends start closed */
+pipe_t* pipe_create(void){
+    pipe_t* pipe = slab_alloc(&pipe_cache);
+
+    if(pipe == NULL){
+        return NULL;
+    }
+    pipe->ring = (uint8_t*)frame_alloc_small();
+    if(pipe->ring == NULL){
+        slab_free(pipe);
+        return NULL;
+    }
+    pipe->head = 0;
+    pipe->tail = 0;
+    pipe->readers = 0;
+    pipe->writers = 0;
+    pipe->read_wait.head = NULL;
+    pipe->read_wait.tail = NULL;
+    pipe->write_wait.head = NULL;
+    pipe->write_wait.tail = NULL;
+    return pipe;
+}
+
+/* void pipe_destroy(pipe_t* pipe)
+ * Inputs: pipe - pipe with both ends closed
+ * Return Value: none
+ * Function: gives the ring frame and the pipe back */
+void pipe_destroy(pipe_t* pipe){
+    frame_free_small((uint32_t)pipe->ring);
+    slab_free(pipe);
+}
+
+/* void pipe_open_read(fd_t* file, pipe_t* pipe)
+ * Inputs: file - free fd entry, pipe - pipe to read from
+ * Return Value: none
+ * Function: makes file the read end of pipe */
+void pipe_open_read(fd_t* file, pipe_t* pipe){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pipe->readers++;
+    restore_flags(flags);
+    file->file_ops_table_ptr = &pipe_read_ops;
+    file->inode = (uint32_t)pipe;
+    file->file_position = 0;
+    file->flags = 1;
+}
+
+/* void pipe_open_write(fd_t* file, pipe_t* pipe)
+ * Inputs: file - free fd entry, pipe - pipe to write to
+ * Return Value: none
+ * Function: makes file the write end of pipe */
+void pipe_open_write(fd_t* file, pipe_t* pipe){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pipe->writers++;
+    restore_flags(flags);
+    file->file_ops_table_ptr = &pipe_write_ops;
+    file->inode = (uint32_t)pipe;
+    file->file_position = 0;
+    file->flags = 1;
+}
+
+/* int pipe_is_end(fd_t* file)
+ * Inputs: file - an fd entry
+ * Return Value: 1 if file is the read or write end of a pipe, 0 otherwise
+ * Function: lets sys_halt close pipes that were handed out as stdin or stdout */
+int pipe_is_end(fd_t* file){
+    return file->file_ops_table_ptr == &pipe_read_ops || file->file_ops_table_ptr == &pipe_write_ops;
+}
+
+/* int32_t pipe_read(fd_t* file, void* buf, int32_t nbytes)
+ * Inputs: file - read end of a pipe
+ *         buf - buffer to fill
+ *         nbytes - most bytes to read
+ * Return Value: bytes read, 0 once the pipe is empty and every write end is closed
+ * Function: blocks while the pipe is empty, then takes whatever is buffered up to nbytes. A blocked
+ *           writer is only woken once half the ring is free, so it refills in big chunks */
+int32_t pipe_read(fd_t* file, void* buf, int32_t nbytes){
+    pipe_t* pipe = (pipe_t*)file->inode;
+    uint32_t flags;
+    uint32_t count, first;
+
+    cli_and_save(flags);
+    while(pipe->head == pipe->tail && pipe->writers > 0){
+        sleep_on(&pipe->read_wait);
+    }
+
+    count = pipe->head - pipe->tail;
+    if(count > (uint32_t)nbytes){
+        count = nbytes;
+    }
+    first = PIPE_SIZE - (pipe->tail & PIPE_MASK);      //Bytes before the ring wraps
+    if(first > count){
+        first = count;
+    }
+    memcpy(buf, pipe->ring + (pipe->tail & PIPE_MASK), first);
+    memcpy((uint8_t*)buf + first, pipe->ring, count - first);
+    pipe->tail += count;
+
+    if(pipe->write_wait.head != NULL && PIPE_SIZE - (pipe->head - pipe->tail) >= PIPE_WAKE){
+        wake_up(&pipe->write_wait);
+    }
+    restore_flags(flags);
+    return count;
+}
+
+/* int32_t pipe_write(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: file - write end of a pipe
+ *         buf - bytes to write
+ *         nbytes - number of bytes
+ * Return Value: nbytes, fewer if the read ends close part way, -1 if no one can read it
+ * Function: copies into the ring, blocking whenever it fills. Readers are woken once when the ring
+ *           fills and once at the end of the call, not for every chunk */
+int32_t pipe_write(fd_t* file, const void* buf, int32_t nbytes){
+    pipe_t* pipe = (pipe_t*)file->inode;
+    uint32_t flags;
+    uint32_t count, first;
+    int32_t written = 0;
+
+    cli_and_save(flags);
+    while(written < nbytes){
+        if(pipe->readers == 0){
+            break;
+        }
+        count = PIPE_SIZE - (pipe->head - pipe->tail);
+        if(count == 0){                                 //Full, let the reader drain half of it
+            wake_up(&pipe->read_wait);
+            while(PIPE_SIZE - (pipe->head - pipe->tail) < PIPE_WAKE && pipe->readers > 0){
+                sleep_on(&pipe->write_wait);
+            }
+            continue;
+        }
+        if(count > (uint32_t)(nbytes - written)){
+            count = nbytes - written;
+        }
+        first = PIPE_SIZE - (pipe->head & PIPE_MASK);
+        if(first > count){
+            first = count;
+        }
+        memcpy(pipe->ring + (pipe->head & PIPE_MASK), (const uint8_t*)buf + written, first);
+        memcpy(pipe->ring, (const uint8_t*)buf + written + first, count - first);
+        pipe->head += count;
+        written += count;
+    }
+    wake_up(&pipe->read_wait);
+    restore_flags(flags);
+
+    if(written == 0 && nbytes > 0){
+        return -1;
+    }
+    return written;
+}
+
+/* int32_t pipe_read_close(fd_t* file)
+ * Inputs: file - read end of a pipe
+ * Return Value: 0
+ * Function: blocked writers wake up and fail, the pipe goes away if the write side is closed too */
+int32_t pipe_read_close(fd_t* file){
+    pipe_t* pipe = (pipe_t*)file->inode;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pipe->readers--;
+    wake_up(&pipe->write_wait);
+    if(pipe->readers == 0 && pipe->writers == 0){
+        pipe_destroy(pipe);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* int32_t pipe_write_close(fd_t* file)
+ * Inputs: file - write end of a pipe
+ * Return Value: 0
+ * Function: blocked readers wake up and see end of file once the ring is drained, the pipe goes
+ *           away if the read side is closed too */
+int32_t pipe_write_close(fd_t* file){
+    pipe_t* pipe = (pipe_t*)file->inode;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pipe->writers--;
+    wake_up(&pipe->read_wait);
+    if(pipe->readers == 0 && pipe->writers == 0){
+        pipe_destroy(pipe);
+    }
+    restore_flags(flags);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#ifndef ASM
+
+#include "types.h"
+#include "fd.h"
+#include "scheduler.h"
+
+#define PIPE_SIZE       0x1000              // ring is one 4KB frame
+#define PIPE_MASK       (PIPE_SIZE - 1)
+#define PIPE_WAKE       (PIPE_SIZE / 2)     // free bytes a blocked writer waits for before it is woken
+
+// an anonymous pipe. head and tail count every byte ever written and read, so head - tail is
+// what is buffered and they only get masked when indexing the ring. A pipe fd keeps its pipe_t
+// in the inode field
+typedef struct pipe {
+    uint8_t* ring;
+    volatile uint32_t head;     // next byte written goes to ring[head & PIPE_MASK]
+    volatile uint32_t tail;     // next byte read comes from ring[tail & PIPE_MASK]
+    int32_t readers;            // open read and write ends
+    int32_t writers;
+    wait_queue_t read_wait;     // readers blocked on an empty pipe
+    wait_queue_t write_wait;    // writers blocked on a full pipe
+} pipe_t;
+
+/* Allocate a pipe with no ends open yet, NULL if out of memory */
+pipe_t* pipe_create(void);
+
+/* Free a pipe once no ends are open, closing the last end does this itself */
+void pipe_destroy(pipe_t* pipe);
+
+/* Point an fd at one end of a pipe and count it as open */
+void pipe_open_read(fd_t* file, pipe_t* pipe);
+void pipe_open_write(fd_t* file, pipe_t* pipe);
+
+int32_t pipe_read(fd_t* file, void* buf, int32_t nbytes);
+
+int32_t pipe_write(fd_t* file, const void* buf, int32_t nbytes);
+
+/* Close one end, the pipe is freed when both sides are closed */
+int32_t pipe_read_close(fd_t* file);
+int32_t pipe_write_close(fd_t* file);
+
+/* Nonzero if the fd is either end of a pipe */
+int pipe_is_end(fd_t* file);
+
+#endif
+
+#endif /* _PIPE_H */
@@ -0,0 +1,48 @@
+/* pit.c - Functions to interact with the 8253/8254 programmable interval timer
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pit.h"
+#include "lib.h"
+#include "scheduler.h"
+
+#define PIT_CHANNEL0_PORT   0x40                // Channel 0 data port, wired to IRQ 0
+#define PIT_COMMAND_PORT    0x43
+#define PIT_IRQ_NUM         0
+#define PIT_SQUARE_WAVE     0x36                // channel 0, lobyte/hibyte, mode 3
+#define PIT_BASE_FREQ       1193182             // input clock of the PIT in Hz
+#define LOW_BYTE            0xFF
+
+volatile uint32_t pit_tick_count = 0;
+
+/* void pit_init(void)
+ * Inputs: void
+ * Return Value: void
+ * Function: programs channel 0 to interrupt PIT_HZ times a second and enables IRQ 0 */
+void pit_init(void) {
+    uint32_t divisor = PIT_BASE_FREQ / PIT_HZ;
+
+    outb(PIT_SQUARE_WAVE, PIT_COMMAND_PORT);
+    outb(divisor & LOW_BYTE, PIT_CHANNEL0_PORT);            // low byte first
+    outb((divisor >> 8) & LOW_BYTE, PIT_CHANNEL0_PORT);     // then high byte
+    enable_irq(PIT_IRQ_NUM);
+}
+
+/* void pit_handler(void)
+ * Inputs: void
+ * Return Value: void
+ * Function: handles PIT interrupts, counts ticks and gives the scheduler a chance to preempt */
+void pit_handler(void) {
+    pit_tick_count++;
+    flush_screen();                         // picks up putc output that no write or printf flushed yet
+    send_eoi(PIT_IRQ_NUM);                  // EOI first, we may not come back here until this process runs again
+    sched_tick();
+}
+
+/* uint32_t pit_ticks(void)
+ * Inputs: void
+ * Return Value: number of ticks since pit_init
+ * Function: reads the tick counter */
+uint32_t pit_ticks(void) {
+    return pit_tick_count;
+}
@@ -0,0 +1,23 @@
+#ifndef _PIT_H
+#define _PIT_H
+
+#ifndef ASM
+
+#include "types.h"
+#include "lib.h"
+#include "i8259.h"
+
+#define PIT_HZ      100     // timer ticks per second
+
+/* Initialize the PIT */
+void pit_init(void);
+
+/* Interrupt handler for the PIT */
+void pit_handler(void);
+
+/* Ticks since pit_init */
+uint32_t pit_ticks(void);
+
+#endif
+
+#endif /* _PIT_H */
@@ -4,6 +4,7 @@
 
 #include "rtc.h"
 #include "lib.h"
+#include "scheduler.h"
 
 #define RTC_REGISTER_PORT   0x70                //Ports 
 #define RTC_CMOS_PORT       0x71
@@ -22,15 +23,89 @@
 #define A_RATE_MASK         0x0F                //Masks for setting the base frequency of Register A
 #define A_PREV_MASK         0xF0
 
-volatile int32_t rtc_int_check = 0;
-int32_t rtc_virtual_freq = MAX_FREQ/MIN_FREQ;
-volatile int32_t rtc_virtual_counter = MAX_FREQ/MIN_FREQ;
+#define RTC_MAX_TIMERS      16                  //Open rtc fds across all processes
+#define RTC_WHEEL_SIZE      (MAX_FREQ/MIN_FREQ) //Longest period in ticks, so every timer fits on the wheel
+#define RTC_NO_TIMER        -1
+
+/* Virtual RTC timers. The RTC always interrupts at MAX_FREQ, every open rtc fd gets a timer that fires
+ * every MAX_FREQ/frequency ticks. Timers sit on a wheel of RTC_WHEEL_SIZE buckets indexed by the tick they
+ * next fire on, so a tick only looks at the timers that expire on it. */
+typedef struct rtc_timer {
+    uint8_t in_use;
+    uint32_t period;            // hardware ticks between virtual interrupts
+    volatile uint32_t fired;    // set when the timer expires, cleared by rtc_read
+    int32_t prev;               // bucket list links, RTC_NO_TIMER at the ends
+    int32_t next;
+    uint32_t bucket;
+    wait_queue_t wait;          // processes blocked in rtc_read on this timer
+} rtc_timer_t;
+
+static rtc_timer_t rtc_timers[RTC_MAX_TIMERS];
+static int32_t rtc_wheel[RTC_WHEEL_SIZE];      // first timer in each bucket
+static uint32_t rtc_wheel_pos = 0;              // bucket of the current tick
+
+/* void rtc_wheel_insert(int32_t t)
+ * Inputs: t - timer index
+ * Return Value: void
+ * Function: puts a timer in the bucket one period from now. Interrupts must be off */
+static void rtc_wheel_insert(int32_t t) {
+    rtc_timer_t* timer = &rtc_timers[t];
+    uint32_t bucket = (rtc_wheel_pos + timer->period) % RTC_WHEEL_SIZE;
+
+    timer->bucket = bucket;
+    timer->prev = RTC_NO_TIMER;
+    timer->next = rtc_wheel[bucket];
+    if (timer->next != RTC_NO_TIMER) {
+        rtc_timers[timer->next].prev = t;
+    }
+    rtc_wheel[bucket] = t;
+}
+
+/* void rtc_wheel_remove(int32_t t)
+ * Inputs: t - timer index
+ * Return Value: void
+ * Function: takes a timer out of its bucket. Interrupts must be off */
+static void rtc_wheel_remove(int32_t t) {
+    rtc_timer_t* timer = &rtc_timers[t];
+
+    if (timer->prev == RTC_NO_TIMER) {
+        rtc_wheel[timer->bucket] = timer->next;
+    } else {
+        rtc_timers[timer->prev].next = timer->next;
+    }
+    if (timer->next != RTC_NO_TIMER) {
+        rtc_timers[timer->next].prev = timer->prev;
+    }
+}
+
+/* int32_t rtc_timer_of(fd_t* file)
+ * Inputs: file - open rtc file passed to an rtc driver function
+ * Return Value: index of the file's timer, -1 if it has none
+ * Function: the timer from rtc_open is kept in the file's inode field */
+static int32_t rtc_timer_of(fd_t* file) {
+    int32_t t;
+
+    if (file == NULL) {
+        return -1;
+    }
+    t = file->inode;
+    if (t < 0 || t >= RTC_MAX_TIMERS || !rtc_timers[t].in_use) {
+        return -1;
+    }
+    return t;
+}
 
 /* void rtc_init(void)
  * Inputs: void
  * Return Value: void
  * Function: initializes the RTC by enabling periodic interrupts */
 void rtc_init(void) {
+    int i;
+
+    for (i = 0; i < RTC_WHEEL_SIZE; i++) {
+        rtc_wheel[i] = RTC_NO_TIMER;
+    }
+
     outb(RTC_REG_B, RTC_REGISTER_PORT);		// select register B
     char prev = inb(RTC_CMOS_PORT);	        // read the current value of register B
     outb(RTC_REG_B, RTC_REGISTER_PORT);		// set the index again (a read will reset the index to register D)
@@ -43,15 +118,22 @@ void rtc_init(void) {
 /* void rtc_handler(void)
  * Inputs: void
  * Return Value: void
- * Function: handles rtc interrupts */
+ * Function: handles rtc interrupts, advances the wheel one tick and fires the timers in that bucket */
 void rtc_handler(void) {
+    int32_t t, next;
+
     outb(RTC_REG_C, RTC_REGISTER_PORT);     //Must read Reg C in order to have another interrupt
     inb(RTC_CMOS_PORT);
 
-    rtc_virtual_counter--;
-    if(rtc_virtual_counter == 0){           //Virtualization loop, count down until counter is 0, then update interrupt check flag
-        rtc_int_check = 1;
-        rtc_virtual_counter = rtc_virtual_freq;     //Reset virtualization counter
+    rtc_wheel_pos = (rtc_wheel_pos + 1) % RTC_WHEEL_SIZE;
+    t = rtc_wheel[rtc_wheel_pos];
+    rtc_wheel[rtc_wheel_pos] = RTC_NO_TIMER;    // detach the bucket, a MAX_FREQ/MIN_FREQ period goes back into it
+    while (t != RTC_NO_TIMER) {
+        next = rtc_timers[t].next;
+        rtc_timers[t].fired = 1;
+        wake_up(&rtc_timers[t].wait);
+        rtc_wheel_insert(t);                     // rearm for the next period
+        t = next;
     }
 
     send_eoi(RTC_INT_NUM);                  //RTC interrupt number is 8
@@ -59,25 +141,45 @@ void rtc_handler(void) {
 
 /* int32_t rtc_open(const uint8_t* filename)
  * Inputs: const uint8_t* filename 
- * Return Value: returns a file descriptor - in this case, always 0
- * Function: Open function for RTC driver, sets virtual frequency to 2Hz */
+ * Return Value: returns the new timer, kept in the fd's inode field, -1 if all timers are taken
+ * Function: Open function for RTC driver, starts a timer at 2Hz */
 int32_t rtc_open(const uint8_t* filename){
-    disable_irq(RTC_INT_NUM);
-    rtc_virtual_freq = MAX_FREQ/MIN_FREQ;       //Change virtual frequency to 2Hz
-    enable_irq(RTC_INT_NUM);
-    return 0;
+    uint32_t flags;
+    int32_t t;
+
+    cli_and_save(flags);
+    for (t = 0; t < RTC_MAX_TIMERS; t++) {
+        if (!rtc_timers[t].in_use) {
+            break;
+        }
+    }
+    if (t == RTC_MAX_TIMERS) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    rtc_timers[t].in_use = 1;
+    rtc_timers[t].period = MAX_FREQ/MIN_FREQ;   //Virtual frequency starts at 2Hz
+    rtc_timers[t].fired = 0;
+    rtc_timers[t].wait.head = NULL;
+    rtc_timers[t].wait.tail = NULL;
+    rtc_wheel_insert(t);
+    restore_flags(flags);
+    return t;
 }
 
-/* int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes)
- * Inputs: fd - File descriptor
+/* int32_t rtc_write(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: file - open rtc file
  *         buf - Buffer containing frequency to be written
  *         nbytes - number of bytes to be written
  * Return Value: 0 on success, -1 on fail
- * Function: Changes the virtual frequency of the RTC */
-int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
+ * Function: Changes the virtual frequency of this file's timer only */
+int32_t rtc_write(fd_t* file, const void* buf, int32_t nbytes){
+    uint32_t flags;
     int32_t frequency;
+    int32_t t = rtc_timer_of(file);
 
-    if(buf == NULL || nbytes != sizeof(int32_t)){
+    if(t == -1 || buf == NULL || nbytes != sizeof(int32_t)){
         return -1;
     }
 
@@ -87,34 +189,53 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
         return -1;
     }
 
-    disable_irq(RTC_INT_NUM);
-    rtc_virtual_freq = MAX_FREQ / frequency;        //Virtualization, set virtual frequency to "frequency"                
-    enable_irq(RTC_INT_NUM);
+    cli_and_save(flags);
+    rtc_wheel_remove(t);
+    rtc_timers[t].period = MAX_FREQ / frequency;    //Virtualization, set virtual frequency to "frequency"
+    rtc_wheel_insert(t);
+    restore_flags(flags);
     return 0;
 }
 
-/* int32_t rtc_read(int32_t fd, const void* buf, int32_t nbytes)
- * Inputs: fd - File descriptor
+/* int32_t rtc_read(fd_t* file, const void* buf, int32_t nbytes)
+ * Inputs: file - open rtc file
  *         buf - Buffer containing frequency to be written to
  *         nbytes - number of bytes to be read
  * Return Value: 0 on success, -1 on fail
- * Function: Wait until an RTC interrupt has occurred */
-int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
-    disable_irq(RTC_INT_NUM);
-    rtc_int_check = 0;          //Set interrupt check flag to 0 to force waiting for interrupt
-    enable_irq(RTC_INT_NUM);
-    while(rtc_int_check == 0); //Loop here and do nothing until the correct number of interrupts have happened
+ * Function: Wait until this file's timer fires */
+int32_t rtc_read(fd_t* file, void* buf, int32_t nbytes){
+    uint32_t flags;
+    int32_t t = rtc_timer_of(file);
+
+    if(t == -1){
+        return -1;
+    }
+
+    cli_and_save(flags);
+    rtc_timers[t].fired = 0;        //Clear the fired flag to force waiting for the next expiry
+    while(rtc_timers[t].fired == 0){
+        sleep_on(&rtc_timers[t].wait);
+    }
+    restore_flags(flags);
     return 0;
 }
 
-/* int32_t rtc_close(int32_t fd)
- * Inputs: fd - the file descriptor
- * Return Value: 0 on success
- * Function: Close function for RTC driver, resets virtual frequency to 2Hz */
-int32_t rtc_close(int32_t fd){
-    disable_irq(RTC_INT_NUM);
-    rtc_virtual_freq = MAX_FREQ/MIN_FREQ;   //Change virtual frequency to 2Hz
-    enable_irq(RTC_INT_NUM);
+/* int32_t rtc_close(fd_t* file)
+ * Inputs: file - open rtc file
+ * Return Value: 0 on success, -1 on fail
+ * Function: Close function for RTC driver, stops and frees the file's timer */
+int32_t rtc_close(fd_t* file){
+    uint32_t flags;
+    int32_t t = rtc_timer_of(file);
+
+    if(t == -1){
+        return -1;
+    }
+
+    cli_and_save(flags);
+    rtc_wheel_remove(t);
+    rtc_timers[t].in_use = 0;
+    restore_flags(flags);
     return 0;
 }
 
@@ -6,6 +6,7 @@
 #include "types.h"
 #include "lib.h"
 #include "i8259.h"
+#include "fd.h"
 
 /* Initialize RTC */
 void rtc_init(void);
@@ -15,11 +16,11 @@ void rtc_handler(void);
 
 int32_t rtc_open(const uint8_t* filename);
 
-int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t rtc_write(fd_t* file, const void* buf, int32_t nbytes);
 
-int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t rtc_read(fd_t* file, void* buf, int32_t nbytes);
 
-int32_t rtc_close(int32_t fd);
+int32_t rtc_close(fd_t* file);
 
 int32_t rtc_change_freq(int32_t frequency);
 
@@ -0,0 +1,198 @@
+/* scheduler.c - Preemptive round-robin scheduling of processes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "scheduler.h"
+#include "lib.h"
+
+static pcb_t* current_task = NULL;  // process on the cpu
+static pcb_t* ready_head = NULL;    // ready queue, linked through next_ready
+static pcb_t* ready_tail = NULL;
+static uint32_t slice_left = TIME_SLICE;
+static volatile int idling = 0;     // set while halted in sleep_on waiting for something to become ready
+
+/* void sched_set_current(pcb_t* pcb)
+ * Inputs: pcb - process that is now on the cpu
+ * Return Value: none
+ * Function: records the running process and gives it a fresh time slice. Used by sys_execute
+ *           and sys_halt, which move between parent and child without going through scheduling */
+void sched_set_current(pcb_t* pcb) {
+    pcb->state = TASK_RUNNING;
+    current_task = pcb;
+    slice_left = TIME_SLICE;
+}
+
+/* pcb_t* sched_current(void)
+ * Inputs: none
+ * Return Value: running process, NULL if nothing has been executed yet
+ * Function: gets the running process */
+pcb_t* sched_current(void) {
+    return current_task;
+}
+
+/* void sched_enqueue(pcb_t* pcb)
+ * Inputs: pcb - process to run later
+ * Return Value: none
+ * Function: adds a process to the back of the ready queue */
+void sched_enqueue(pcb_t* pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pcb->state = TASK_READY;
+    pcb->next_ready = NULL;
+    if (ready_tail == NULL) {
+        ready_head = pcb;
+    } else {
+        ready_tail->next_ready = pcb;
+    }
+    ready_tail = pcb;
+    restore_flags(flags);
+}
+
+/* pcb_t* sched_dequeue(void)
+ * Inputs: none
+ * Return Value: process at the front of the ready queue, NULL if it is empty
+ * Function: removes the front of the ready queue. Interrupts must be off */
+static pcb_t* sched_dequeue(void) {
+    pcb_t* pcb = ready_head;
+
+    if (pcb != NULL) {
+        ready_head = pcb->next_ready;
+        if (ready_head == NULL) {
+            ready_tail = NULL;
+        }
+        pcb->next_ready = NULL;
+    }
+    return pcb;
+}
+
+/* void sched_tick(void)
+ * Inputs: none
+ * Return Value: none
+ * Function: counts down the running process's time slice and preempts it when the slice is used up */
+void sched_tick(void) {
+    if (idling) {                   // nothing is running, sleep_on picks the next process itself
+        return;
+    }
+    if (slice_left > 1) {
+        slice_left--;
+        return;
+    }
+    slice_left = TIME_SLICE;
+    scheduling();
+}
+
+/* void switch_to(pcb_t* prev, pcb_t* next)
+ * Inputs: prev - process giving up the cpu, next - process taking it
+ * Return Value: none
+ * Function: its pid, TSS esp0, user page and CR3 come from switch_process, then its kernel esp/ebp
+ *           from context_switch. Returns when prev is picked again. Interrupts must be off */
+static void switch_to(pcb_t* prev, pcb_t* next) {
+    sched_set_current(next);
+    if (next == prev) {
+        return;
+    }
+    switch_process(next->pid);
+    context_switch(&prev->sched_esp, &prev->sched_ebp, next->sched_esp, next->sched_ebp);
+}
+
+/* void scheduling(void)
+ * Inputs: none
+ * Return Value: none
+ * Function: round robin. Puts the running process at the back of the ready queue and switches to the
+ *           front one. Returns when this process is picked again. */
+void scheduling(void) {
+    uint32_t flags;
+    pcb_t* prev;
+    pcb_t* next;
+
+    cli_and_save(flags);
+    prev = current_task;
+    if (prev == NULL || ready_head == NULL) {       // nothing else to run
+        restore_flags(flags);
+        return;
+    }
+
+    next = sched_dequeue();
+    if (prev->state == TASK_RUNNING) {
+        sched_enqueue(prev);
+    }
+    switch_to(prev, next);
+
+    restore_flags(flags);                           // back on prev's stack
+}
+
+/* void sleep_on(wait_queue_t* wq)
+ * Inputs: wq - queue to wait on
+ * Return Value: none
+ * Function: blocks the running process until wake_up(wq) and runs something else meanwhile. If nothing
+ *           is ready the cpu halts until an interrupt readies a process. Called with interrupts off,
+ *           returns with them off; callers loop on their condition since a wake up may be for another waiter */
+void sleep_on(wait_queue_t* wq) {
+    pcb_t* prev = current_task;
+    pcb_t* next;
+
+    if (prev == NULL) {                             // no processes yet, just wait for the next interrupt
+        sti();
+        asm volatile ("hlt");
+        cli();
+        return;
+    }
+
+    prev->state = TASK_SLEEPING;
+    prev->next_ready = NULL;
+    if (wq->tail == NULL) {
+        wq->head = prev;
+    } else {
+        wq->tail->next_ready = prev;
+    }
+    wq->tail = prev;
+
+    idling = 1;
+    while (ready_head == NULL) {                    // idle: sti and hlt back to back so a wake up can't slip in between
+        asm volatile ("sti; hlt; cli");
+    }
+    idling = 0;
+
+    next = sched_dequeue();
+    switch_to(prev, next);
+}
+
+/* void sched_exit(void)
+ * Inputs: none
+ * Return Value: never returns
+ * Function: switches away from a process that is gone. It stays off the ready queue, so its stack is
+ *           never resumed. Idles like sleep_on until something is ready. Called with interrupts off */
+void sched_exit(void) {
+    pcb_t* prev = current_task;
+
+    prev->state = TASK_DEAD;
+    idling = 1;
+    while (ready_head == NULL) {
+        asm volatile ("sti; hlt; cli");
+    }
+    idling = 0;
+
+    switch_to(prev, sched_dequeue());
+}
+
+/* void wake_up(wait_queue_t* wq)
+ * Inputs: wq - queue to wake
+ * Return Value: none
+ * Function: moves every process waiting on wq to the ready queue. Safe to call from interrupt handlers */
+void wake_up(wait_queue_t* wq) {
+    uint32_t flags;
+    pcb_t* pcb;
+    pcb_t* next;
+
+    cli_and_save(flags);
+    pcb = wq->head;
+    wq->head = NULL;
+    wq->tail = NULL;
+    while (pcb != NULL) {
+        next = pcb->next_ready;
+        sched_enqueue(pcb);
+        pcb = next;
+    }
+    restore_flags(flags);
+}
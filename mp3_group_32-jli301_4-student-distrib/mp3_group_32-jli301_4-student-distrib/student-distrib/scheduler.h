@@ -0,0 +1,52 @@
+/* scheduler.h - Defines for the round-robin process scheduler
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#ifndef ASM
+
+#include "types.h"
+#include "system_call.h"
+
+#define TIME_SLICE      2   // PIT ticks a process runs before it is preempted
+
+/* Process states */
+#define TASK_RUNNING    0   // on the cpu
+#define TASK_READY      1   // in the ready queue
+#define TASK_WAITING    2   // parent blocked in sys_execute until its child halts
+#define TASK_SLEEPING   3   // blocked on a wait queue
+#define TASK_DEAD       4   // halted with no parent to return to, its slot is already free
+
+/* Processes blocked until an interrupt handler wakes them, linked through next_ready */
+typedef struct wait_queue {
+    pcb_t* head;
+    pcb_t* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT {NULL, NULL}
+
+/* Make pcb the running process without switching to it */
+void sched_set_current(pcb_t* pcb);
+/* Running process, NULL before the first sys_execute */
+pcb_t* sched_current(void);
+/* Add a process to the back of the ready queue */
+void sched_enqueue(pcb_t* pcb);
+/* Called on every PIT tick, preempts when the time slice runs out */
+void sched_tick(void);
+/* Switch to the next ready process, if there is one */
+void scheduling(void);
+/* Block the running process on wq, interrupts must be off */
+void sleep_on(wait_queue_t* wq);
+/* Give up the cpu for good, for a process that halts with no parent. Interrupts must be off */
+void sched_exit(void);
+/* Make every process on wq ready again */
+void wake_up(wait_queue_t* wq);
+
+/* Saves callee-saved registers, esp and ebp, then resumes the other stack */
+extern void context_switch(uint32_t* save_esp, uint32_t* save_ebp, uint32_t esp, uint32_t ebp);
+
+#endif
+
+#endif /* _SCHEDULER_H */
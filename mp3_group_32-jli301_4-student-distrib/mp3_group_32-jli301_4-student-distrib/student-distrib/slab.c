@@ -0,0 +1,221 @@
+/* slab.c - Slab allocator for kernel objects, backed by 4KB frames
+ * vim:ts=4 noexpandtab
+ */
+
+#include "slab.h"
+#include "frame.h"
+#include "lib.h"
+
+#define SLAB_ALIGN      8
+
+// header at the start of every slab's frame, objects follow it
+struct slab {
+    slab_cache_t* cache;
+    slab_t* prev;
+    slab_t* next;
+    void* free;             // first free object, each free object holds the next one
+    uint32_t in_use;
+};
+
+#define SLAB_HEADER_SIZE    ((sizeof(slab_t) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+static slab_cache_t kmalloc_caches[KMALLOC_CACHES] = {
+    SLAB_CACHE_INIT("kmalloc-32", 32),
+    SLAB_CACHE_INIT("kmalloc-64", 64),
+    SLAB_CACHE_INIT("kmalloc-128", 128),
+    SLAB_CACHE_INIT("kmalloc-256", 256),
+    SLAB_CACHE_INIT("kmalloc-512", 512),
+    SLAB_CACHE_INIT("kmalloc-1024", 1024),
+    SLAB_CACHE_INIT("kmalloc-2048", 2048),
+};
+
+/* void slab_unlink(slab_t** list, slab_t* slab)
+ * Inputs: list: head of the list the slab is on, slab: slab to take off it
+ * Return Value: void
+ * Function: removes a slab from a doubly linked slab list */
+static void slab_unlink(slab_t** list, slab_t* slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+/* void slab_push(slab_t** list, slab_t* slab)
+ * Inputs: list: head of a slab list, slab: slab to put at its front
+ * Return Value: void
+ * Function: adds a slab to a doubly linked slab list */
+static void slab_push(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/* slab_t* slab_grow(slab_cache_t* cache)
+ * Inputs: cache: cache that ran out of free objects
+ * Return Value: a new slab with every object free, NULL if there is no frame or the object is too big
+ * Function: carves a 4KB frame into objects and threads them on the slab's freelist */
+static slab_t* slab_grow(slab_cache_t* cache) {
+    slab_t* slab;
+    uint8_t* obj;
+    uint32_t i;
+
+    if (cache->objs_per_slab == 0) {        // first use, settle the layout
+        if (cache->obj_size < SLAB_MIN_OBJ) {
+            cache->obj_size = SLAB_MIN_OBJ;
+        }
+        cache->obj_size = (cache->obj_size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+        cache->objs_per_slab = (FRAME_SIZE - SLAB_HEADER_SIZE) / cache->obj_size;
+        if (cache->objs_per_slab == 0) {
+            return NULL;
+        }
+    }
+
+    slab = (slab_t*)frame_alloc_small();
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->cache = cache;
+    slab->prev = slab->next = NULL;
+    slab->in_use = 0;
+    slab->free = NULL;
+    obj = (uint8_t*)slab + SLAB_HEADER_SIZE + (cache->objs_per_slab - 1) * cache->obj_size;
+    for (i = 0; i < cache->objs_per_slab; i++, obj -= cache->obj_size) {    // low addresses come out first
+        *(void**)obj = slab->free;
+        slab->free = obj;
+    }
+    cache->slabs++;
+    return slab;
+}
+
+/* void* slab_alloc(slab_cache_t* cache)
+ * Inputs: cache: cache to take an object from
+ * Return Value: an uninitialized object, NULL if no memory is left
+ * Function: takes the first free object of a partial slab, falling back to the empty slab and then a new one.
+ *           Runs with interrupts off so it can be called from anywhere */
+void* slab_alloc(slab_cache_t* cache) {
+    uint32_t flags;
+    slab_t* slab;
+    void* obj = NULL;
+
+    cli_and_save(flags);
+    slab = cache->partial;
+    if (slab == NULL) {
+        slab = cache->empty;
+        if (slab != NULL) {
+            cache->empty = NULL;
+        } else {
+            slab = slab_grow(cache);
+        }
+        if (slab != NULL) {
+            slab_push(&cache->partial, slab);
+        }
+    }
+
+    if (slab != NULL) {
+        obj = slab->free;
+        slab->free = *(void**)obj;
+        slab->in_use++;
+        if (slab->free == NULL) {
+            slab_unlink(&cache->partial, slab);
+            slab_push(&cache->full, slab);
+        }
+        cache->active++;
+        cache->allocs++;
+    } else {
+        cache->failed++;
+    }
+    restore_flags(flags);
+    return obj;
+}
+
+/* void slab_free(void* obj)
+ * Inputs: obj: object from slab_alloc, NULL is ignored
+ * Return Value: void
+ * Function: the slab is found from the object's frame. A slab that becomes empty is kept as the cache's
+ *           spare if it has none, otherwise its frame is given back, so a cache never holds more than
+ *           one empty frame no matter how alloc and free interleave */
+void slab_free(void* obj) {
+    uint32_t flags;
+    slab_t* slab;
+    slab_cache_t* cache;
+
+    if (obj == NULL) {
+        return;
+    }
+    cli_and_save(flags);
+    slab = (slab_t*)((uint32_t)obj & ~(FRAME_SIZE - 1));
+    cache = slab->cache;
+
+    if (slab->free == NULL) {               // was full
+        slab_unlink(&cache->full, slab);
+        slab_push(&cache->partial, slab);
+    }
+    *(void**)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+    cache->active--;
+    cache->frees++;
+
+    if (slab->in_use == 0) {
+        slab_unlink(&cache->partial, slab);
+        if (cache->empty == NULL) {
+            cache->empty = slab;
+        } else {
+            cache->slabs--;
+            frame_free_small((uint32_t)slab);
+        }
+    }
+    restore_flags(flags);
+}
+
+/* void* kmalloc(uint32_t size)
+ * Inputs: size: bytes wanted
+ * Return Value: a buffer of at least size bytes, NULL if size is 0, over 2048 or no memory is left
+ * Function: rounds up to the next power of two size class */
+void* kmalloc(uint32_t size) {
+    uint32_t i;
+
+    for (i = 0; i < KMALLOC_CACHES; i++) {
+        if (size <= (1 << (KMALLOC_MIN_SHIFT + i))) {
+            return (size == 0) ? NULL : slab_alloc(&kmalloc_caches[i]);
+        }
+    }
+    return NULL;
+}
+
+/* void kfree(void* obj)
+ * Inputs: obj: buffer from kmalloc, NULL is ignored
+ * Return Value: void
+ * Function: the size class is found from the slab header, same as slab_free */
+void kfree(void* obj) {
+    slab_free(obj);
+}
+
+/* void slab_print_stats(slab_cache_t* cache)
+ * Inputs: cache: cache to report on
+ * Return Value: void
+ * Function: prints object size, frames held, objects in use against capacity and lifetime counts */
+void slab_print_stats(slab_cache_t* cache) {
+    printf("%s: size %d, slabs %d, active %d/%d, allocs %d, frees %d, failed %d\n",
+            cache->name, cache->obj_size, cache->slabs, cache->active, cache->slabs * cache->objs_per_slab,
+            cache->allocs, cache->frees, cache->failed);
+}
+
+/* void kmalloc_print_stats(void)
+ * Inputs: void
+ * Return Value: void
+ * Function: prints every kmalloc size class */
+void kmalloc_print_stats(void) {
+    int i;
+    for (i = 0; i < KMALLOC_CACHES; i++) {
+        slab_print_stats(&kmalloc_caches[i]);
+    }
+}
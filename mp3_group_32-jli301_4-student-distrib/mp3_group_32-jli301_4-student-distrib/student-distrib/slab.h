@@ -0,0 +1,48 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#ifndef ASM
+
+#include "types.h"
+
+#define SLAB_MIN_OBJ        8           // smallest object, a free object holds the freelist link
+#define KMALLOC_MIN_SHIFT   5           // kmalloc size classes are 32, 64, ... 2048 bytes
+#define KMALLOC_CACHES      7
+
+typedef struct slab slab_t;
+
+// a cache hands out objects of one size from 4KB slabs. Slabs with free objects sit on partial,
+// full ones on full, and at most one empty slab is kept around so a free/alloc pair at a slab
+// boundary does not bounce a frame back and forth
+typedef struct slab_cache {
+    const char* name;
+    uint32_t obj_size;
+    uint32_t objs_per_slab;
+    slab_t* partial;
+    slab_t* full;
+    slab_t* empty;
+    uint32_t slabs;         // frames the cache holds, including the empty one
+    uint32_t active;        // objects handed out right now
+    uint32_t allocs;        // lifetime counts
+    uint32_t frees;
+    uint32_t failed;        // allocations that found no frame
+} slab_cache_t;
+
+#define SLAB_CACHE_INIT(cache_name, size) \
+    { (cache_name), (size), 0, NULL, NULL, NULL, 0, 0, 0, 0, 0 }
+
+/* Allocate and free objects of one cache */
+void* slab_alloc(slab_cache_t* cache);
+void slab_free(void* obj);
+
+/* Size class allocation for buffers, kfree works on anything slab_alloc or kmalloc returned */
+void* kmalloc(uint32_t size);
+void kfree(void* obj);
+
+/* Print the statistics of one cache, or of every kmalloc cache */
+void slab_print_stats(slab_cache_t* cache);
+void kmalloc_print_stats(void);
+
+#endif
+
+#endif /* _SLAB_H */
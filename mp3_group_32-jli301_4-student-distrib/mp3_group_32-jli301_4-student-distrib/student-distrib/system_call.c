@@ -1,11 +1,19 @@
 #include "system_call.h"
+#include "scheduler.h"
+#include "pipe.h"
 
-pcb_t cur_pcb; // global variables to keep track of pcb and pid
-int cur_pid;
 int num_processes;
+uint8_t pid_in_use[OVER_MAX_PROCESSES]; // pcb/kernel stack slots taken by live processes
+static paging_table_t vidmap_tables[NUM_TERMINALS][ENTRIES] __attribute__((aligned(4096))); // the VID_MEM_ADDR page of each terminal
+static slab_cache_t fd_table_cache = SLAB_CACHE_INIT("fd_table", MAX_FILES * sizeof(fd_t));
 
 uint8_t magic_num[4] = {0x7f, 0x45, 0x4c, 0x46}; // array with magic numbers to check in meta date to see if an EXE file
 
+#ifdef DEMAND_PAGED_EXEC
+// one 4KB page table per process for the 128MB user page, entries start not present
+static paging_table_t user_page_tables[OVER_MAX_PROCESSES][ENTRIES] __attribute__((aligned(4096)));
+#endif
+
 // file operations tables for files, directories, terminal, rtc, stdin, and stdout
 struct file_operations reg_file = {
     .open = &file_open,
@@ -34,12 +42,12 @@ struct file_operations reg_rtc = {
 struct file_operations reg_stdin = {
     .open = &bad_call,
     .read = &terminal_read,
-    .write = &terminal_write,
+    .write = &bad_call,
     .close = &bad_call};
 
 struct file_operations reg_stdout = {
     .open = &bad_call,
-    .read = &terminal_read,
+    .read = &bad_call,
     .write = &terminal_write,
     .close = &bad_call};
 
@@ -49,22 +57,24 @@ struct file_operations reg_stdout = {
  * Function: initializes a file descriptor */
 void file_desc_init()
 {
-    cur_pcb = *(pcb_t *)(get_PCB_addr()); // gets current pcb
+    pcb_t *cur_pcb = get_cur_PCB(); // the boot stack's pcb, used by the kernel before the first execute
+    cur_pcb->file_descriptor = slab_alloc(&fd_table_cache);
+    cur_pcb->cr3 = (uint32_t)paging_directory;
 
     // Mark stdin and stdout as "Open"
-    cur_pcb.file_descriptor[0].flags = 1;
-    cur_pcb.file_descriptor[0].file_ops_table_ptr = &reg_stdin; // or without .read
-    cur_pcb.file_descriptor[1].flags = 1;
-    cur_pcb.file_descriptor[1].file_ops_table_ptr = &reg_stdout;
+    cur_pcb->file_descriptor[0].flags = 1;
+    cur_pcb->file_descriptor[0].file_ops_table_ptr = &reg_stdin; // or without .read
+    cur_pcb->file_descriptor[1].flags = 1;
+    cur_pcb->file_descriptor[1].file_ops_table_ptr = &reg_stdout;
 
     // initializes rest of entries in file descriptor array to empty
     int i;
     for (i = 2; i < MAX_FILES; i++)
     {
-        cur_pcb.file_descriptor[i].file_ops_table_ptr = NULL;
-        cur_pcb.file_descriptor[i].inode = -1;
-        cur_pcb.file_descriptor[i].file_position = 0;
-        cur_pcb.file_descriptor[i].flags = 0;
+        cur_pcb->file_descriptor[i].file_ops_table_ptr = NULL;
+        cur_pcb->file_descriptor[i].inode = -1;
+        cur_pcb->file_descriptor[i].file_position = 0;
+        cur_pcb->file_descriptor[i].flags = 0;
     }
 }
 
@@ -85,6 +95,8 @@ int32_t bad_call()
  */
 int32_t sys_halt(uint8_t status)
 {
+    cli(); // no preemption while switching back to the parent, its iret turns interrupts back on
+
     /* Set up Return Value */
     // Check if exception
     if (status == (uint8_t)50)
@@ -94,9 +106,24 @@ int32_t sys_halt(uint8_t status)
     // Check if program finished
 
     /* Close all open files */
-    pcb_t *pcb_to_clear = (pcb_t *)get_PCB_addr(); // Get the address of the PCB to clear
+    pcb_t *pcb_to_clear = get_cur_PCB(); // Get the address of the PCB to clear
+    pcb_t *parent;
 
     int fd_index;
+    for (fd_index = 2; fd_index < MAX_FILES; fd_index++)
+    { // let the drivers release what they hold for open files (rtc timers)
+        if (pcb_to_clear->file_descriptor[fd_index].flags != 0)
+        {
+            sys_close(fd_index);
+        }
+    }
+    for (fd_index = 0; fd_index < 2; fd_index++)
+    { // a pipeline hands out pipe ends as stdin and stdout, sys_close won't touch those
+        if (pipe_is_end(&pcb_to_clear->file_descriptor[fd_index]))
+        {
+            pcb_to_clear->file_descriptor[fd_index].file_ops_table_ptr->close(&pcb_to_clear->file_descriptor[fd_index]);
+        }
+    }
     for (fd_index = 0; fd_index < MAX_FILES; fd_index++)
     {                                                                      // Loop to clear all fds
         pcb_to_clear->file_descriptor[fd_index].file_ops_table_ptr = NULL; // Set file ops to NULL, and set all flags to 0
@@ -109,17 +136,37 @@ int32_t sys_halt(uint8_t status)
     memset(pcb_to_clear->arg, 0, sizeof(pcb_to_clear->arg));
     pcb_to_clear->file_len = 0;
     pcb_to_clear->arg_len = 0;
+    pcb_to_clear->vidmap = 0;
+
+    loadPagingDirectory((unsigned int *)paging_directory); // off the child's directory before it goes back
+    page_dir_free((page_dir_t *)pcb_to_clear->cr3);
 
-    if (cur_pid <= 0)
-    { // If this is the last process, restart the main shell.
+    frame_free_big(pcb_to_clear->user_frame);
+    if (pcb_to_clear->mmap_table != NULL)
+    { // mapped files are just filesystem blocks, only the page table goes back
+        frame_free_small((uint32_t)pcb_to_clear->mmap_table);
+        pcb_to_clear->mmap_table = NULL;
+    }
+    slab_free(pcb_to_clear->file_descriptor);
+    pid_in_use[pcb_to_clear->pid] = 0; // slot can be reused by the next execute
+
+    if (pcb_to_clear->parent_pid == NO_PARENT)
+    { // If this is a base shell, restart it.
         num_processes--;
-        sys_execute((const uint8_t *)"shell");
+        execute_program((const uint8_t *)"shell", NO_PARENT, pcb_to_clear->terminal);
         return -1;
     }
 
-    cur_pid = pcb_to_clear->parent_pid; // cur_pid = parent's, pcb_to_clear = current pcb to be halted
-    cur_pcb = *(pcb_t *)(get_PCB_addr());
+    if (pcb_to_clear->parent_pid == DETACHED)
+    { // left side of a pipeline, no one waits for it
+        pcb_to_clear->active = 0;
+        num_processes--;
+        sched_exit(); // never comes back to this stack
+    }
+
+    parent = (pcb_t *)(addr_8MB - (size_8kb * (pcb_to_clear->parent_pid + 1))); // pcb_to_clear = current pcb to be halted
     pcb_to_clear->active = 0; // Set process to inactive (As per review slides)
+    sched_set_current(parent); // parent runs again
 
     num_processes--; // Decrement the number of processes
 
@@ -130,15 +177,13 @@ int32_t sys_halt(uint8_t status)
 
     // Set TSS for parent
     tss.ss0 = KERNEL_DS;                            // sets the ss0 in TSS to be the Kernal for memory
-    tss.esp0 = addr_8MB - (size_8kb * cur_pid) - 4; // kernel stack pointer
+    tss.esp0 = parent->esp0; // kernel stack pointer
 
-    // Map parent's paging
-    map((void *)USER_SPACE, (void *)(addr_8MB + cur_pid * _4MB)); // uses the map function to map the parent page
-
-    flush_TLB(); // resets the CR3 value
+    // Map parent's paging, its mappings never went away
+    loadPagingDirectory((unsigned int *)parent->cr3);
 
     // Set parent's process as active
-    cur_pcb.active = 1;
+    parent->active = 1;
 
     /* Halt return */
     // ret_halt(status, cur_pcb.saved_ebp, cur_pcb.saved_esp);
@@ -156,24 +201,83 @@ int32_t sys_halt(uint8_t status)
     return 1;
 }
 
+static int32_t find_pipe_char(const uint8_t *command);
+static int32_t execute_pipeline(const uint8_t *command, int32_t parent_pid, uint8_t terminal);
+
 /* int32_t sys_execute (const uint8_t* command)
  *  input   : pointer to command buffer
  *  output  : nothing
- *  return  : 0 if sucessful, -1 if fail
- *  Description : This function intakes the command buffer, checks if it is an EXE file, and executes the specific file function.
+ *  return  : status passed to halt by the program, -1 if fail
+ *  Description : runs command as a child of the running process, or as a base shell if nothing
+ *                is running yet. Interrupts stay off until the child is running.
  */
 int32_t sys_execute(const uint8_t *command)
+{
+    uint32_t flags;
+    int32_t ret;
+
+    cli_and_save(flags);
+    if (sched_current() == NULL)
+    { // first shell, started by the kernel
+        ret = execute_program(command, NO_PARENT, terminal_shown());
+    }
+    else if (find_pipe_char(command) != -1)
+    {
+        ret = execute_pipeline(command, get_cur_PCB()->pid, get_cur_PCB()->terminal);
+    }
+    else
+    {
+        ret = execute_program(command, get_cur_PCB()->pid, get_cur_PCB()->terminal);
+    }
+    restore_flags(flags);
+
+    return ret;
+}
+
+/* int find_free_pid()
+ *  input   : none
+ *  output  : none
+ *  return  : first pid whose pcb slot is free, -1 if all OVER_MAX_PROCESSES are taken
+ *  Description : helper for execute_program
+ */
+static int find_free_pid()
+{
+    int pid;
+    for (pid = 0; pid < OVER_MAX_PROCESSES; pid++)
+    {
+        if (!pid_in_use[pid])
+        {
+            return pid;
+        }
+    }
+    return -1;
+}
+
+/* pcb_t* create_process (const uint8_t* command, int32_t parent_pid, uint8_t terminal)
+ *  input   : pointer to command buffer, pid of the parent or NO_PARENT, terminal of the new process
+ *  output  : the new pcb and its user pages are set up, nothing is switched to it
+ *  return  : the new pcb, NULL if fail
+ *  Description : This function intakes the command buffer, checks if it is an EXE file, and sets up a process for it.
+ *                Called with interrupts off.
+ */
+static pcb_t *create_process(const uint8_t *command, int32_t parent_pid, uint8_t terminal)
 {
     int i, j;
     int argFlag = 0;
     uint32_t cmd_addr;
+    int pid = find_free_pid();
 
-    if (num_processes >= OVER_MAX_PROCESSES)
+    if (pid == -1)
     { // Make sure we do not go above the maximum number of processes
-        return -1;
+        return NULL;
     }
 
-    pcb_t *new_pcb_ptr = (pcb_t *)(addr_8MB - (size_8kb * (num_processes + 1))); // Different from PID
+    pcb_t *new_pcb_ptr = (pcb_t *)(addr_8MB - (size_8kb * (pid + 1)));
+
+    memset(new_pcb_ptr->file, 0, sizeof(new_pcb_ptr->file)); // the slot may hold whatever the last process left
+    memset(new_pcb_ptr->arg, 0, sizeof(new_pcb_ptr->arg));
+    new_pcb_ptr->file_len = 0;
+    new_pcb_ptr->arg_len = 0;
 
     /* Parse cmd */
     // parse the command and grab the command and argumends seperate
@@ -181,11 +285,11 @@ int32_t sys_execute(const uint8_t *command)
 
     if (command == NULL)
     {
-        return -1;
+        return NULL;
     } // checks if the command is valid (ie. NULL or just Enter)
     if (command[0] == ENTER || command[0] == '\0')
     {
-        return -1;
+        return NULL;
     }
 
     for (i = 0; i < MAX_NAME_LENGTH; i++)
@@ -228,7 +332,7 @@ int32_t sys_execute(const uint8_t *command)
         memset(new_pcb_ptr->arg, 0, sizeof(new_pcb_ptr->file));
         new_pcb_ptr->file_len = 0;
         new_pcb_ptr->arg_len = 0;
-        return -1;
+        return NULL;
     }
 
     uint8_t magic_num_buf[4]; // instantiates the buffers for the two read datas
@@ -240,7 +344,7 @@ int32_t sys_execute(const uint8_t *command)
     cmd_read_1 = read_data(cmd_dentry.inode_number, 0, magic_num_buf, 4); // read first 4 bytes of inode at address
     if (cmd_read_1 != 4)
     {
-        return -1;
+        return NULL;
     } // did not read all 4.. return -1?
 
     int exeFlag = 0;
@@ -262,28 +366,49 @@ int32_t sys_execute(const uint8_t *command)
 
     if (exeFlag != 1)
     {
-        return -1;
+        return NULL;
     } // if not an EXE file, then return FAIL
 
     cmd_read_2 = read_data(cmd_dentry.inode_number, 24, eip_buf, 4); // read first 4 bytes of inode at address
     if (cmd_read_2 != 4)
     {
-        return -1;
+        return NULL;
     } // did not read all 4.. return -1?
 
     cmd_addr = (eip_buf[3] << 24 | eip_buf[2] << 16 | eip_buf[1] << 8 | eip_buf[0]); // its loaded in backwards, bit shifts the buffer bytes into correct 32bit value.
 
-    if (num_processes == 0)
+    new_pcb_ptr->user_frame = frame_alloc_big();
+    if (new_pcb_ptr->user_frame == FRAME_NONE)
+    { // out of physical memory for another user page
+        return NULL;
+    }
+    new_pcb_ptr->file_descriptor = slab_alloc(&fd_table_cache);
+    if (new_pcb_ptr->file_descriptor == NULL)
     {
-        new_pcb_ptr->parent_pid = -1; // If this is the first process, set parent PID to -1
+        frame_free_big(new_pcb_ptr->user_frame);
+        return NULL;
     }
-    else
+    new_pcb_ptr->cr3 = (uint32_t)page_dir_create();
+    if (new_pcb_ptr->cr3 == 0)
     {
-        new_pcb_ptr->parent_pid = cur_pid; // Otherwise, set the parent PID to the PID of the previous PCB
+        slab_free(new_pcb_ptr->file_descriptor);
+        frame_free_big(new_pcb_ptr->user_frame);
+        return NULL;
     }
-    new_pcb_ptr->pid = num_processes; // Set the new PCB's PID, set the new PCB as active, and deactivate the old PCB
-    cur_pcb.active = 0;               // Only changed these because the review slides said to
+
+    new_pcb_ptr->parent_pid = parent_pid; // NO_PARENT for a base shell
+    new_pcb_ptr->pid = pid;
+    pid_in_use[pid] = 1;
     new_pcb_ptr->active = 1;
+    new_pcb_ptr->esp0 = addr_8MB - (pid * size_8kb) - 4;
+    new_pcb_ptr->terminal = terminal;
+    new_pcb_ptr->vidmap = 0;
+    new_pcb_ptr->entry = cmd_addr;
+    new_pcb_ptr->mmap_table = NULL;
+    new_pcb_ptr->mmap_next = 0;
+
+    new_pcb_ptr->exe_inode = cmd_dentry.inode_number; // remember the image for demand paging
+    new_pcb_ptr->exe_length = get_inode_length(cmd_dentry.inode_number);
 
     new_pcb_ptr->file_descriptor[0].flags = 1; // Set in-use flags to 1 and add stdin and stdout as operations
     new_pcb_ptr->file_descriptor[0].file_ops_table_ptr = &reg_stdin;
@@ -292,27 +417,75 @@ int32_t sys_execute(const uint8_t *command)
 
     for (j = 2; j < MAX_FILES; j++)
     {
-        new_pcb_ptr->file_descriptor[i].file_ops_table_ptr = NULL; // Mark the rest of the PCB as empty by setting flags to 0 and ops to NULL
-        new_pcb_ptr->file_descriptor[i].inode = 0;
-        new_pcb_ptr->file_descriptor[i].file_position = 0;
-        new_pcb_ptr->file_descriptor[i].flags = 0;
+        new_pcb_ptr->file_descriptor[j].file_ops_table_ptr = NULL; // Mark the rest of the PCB as empty by setting flags to 0 and ops to NULL
+        new_pcb_ptr->file_descriptor[j].inode = 0;
+        new_pcb_ptr->file_descriptor[j].file_position = 0;
+        new_pcb_ptr->file_descriptor[j].flags = 0;
     }
-
-    cur_pid = new_pcb_ptr->pid; // Update the cur_pid, cur_pcb, and the number of processes
-    cur_pcb = *new_pcb_ptr;
     num_processes++;
 
     /* Set up Memory */
-    map((void *)USER_SPACE, (void *)(addr_8MB + cur_pid * _4MB)); // sets up the memory by calling map function to map virtual and physical memory
-    flush_TLB();                                                  // reset the cr3 value
-
+#ifdef DEMAND_PAGED_EXEC
+    memset(user_page_tables[pid], 0, sizeof(user_page_tables[pid])); // nothing is loaded yet, Page_fault fills pages in
+#ifdef SHARED_EXEC_PAGES
+    share_program_pages(pid, cmd_dentry.inode_number, new_pcb_ptr->exe_length);
+#endif
+    map_user(pid);
+#else
     /* Read exe Data */
-    // 24 offest store into eip 4 bytes
+    map_user(pid);
+    loadPagingDirectory((unsigned int *)new_pcb_ptr->cr3); // load through the new process's directory, then go back
     read_data((uint32_t)cmd_dentry.inode_number, (uint32_t)0, (uint8_t *)PROGRAM_IMG, (uint32_t)_4MB);
+    loadPagingDirectory((unsigned int *)get_cur_PCB()->cr3);
+#endif
+
+    return new_pcb_ptr;
+}
+
+static int32_t run_process(pcb_t *new_pcb_ptr, int32_t parent_pid, uint8_t terminal);
+
+/* int32_t execute_program (const uint8_t* command, int32_t parent_pid, uint8_t terminal)
+ *  input   : pointer to command buffer, pid of the parent or NO_PARENT, terminal of the new process
+ *  output  : nothing
+ *  return  : status passed to halt by the program, -1 if fail
+ *  Description : creates the process and runs it right away in place of the caller, which waits
+ *                until it halts. Called with interrupts off.
+ */
+int32_t execute_program(const uint8_t *command, int32_t parent_pid, uint8_t terminal)
+{
+    pcb_t *new_pcb_ptr = create_process(command, parent_pid, terminal);
+
+    if (new_pcb_ptr == NULL)
+    {
+        return -1;
+    }
+
+    return run_process(new_pcb_ptr, parent_pid, terminal);
+}
+
+/* int32_t run_process (pcb_t* new_pcb_ptr, int32_t parent_pid, uint8_t terminal)
+ *  input   : a process from create_process, pid of its parent or NO_PARENT, its terminal
+ *  output  : nothing
+ *  return  : status passed to halt by the program
+ *  Description : switches to the new process in place of the caller. sys_halt returns from
+ *                this function on the saved esp and ebp. Called with interrupts off.
+ */
+static int32_t run_process(pcb_t *new_pcb_ptr, int32_t parent_pid, uint8_t terminal)
+{
+    if (parent_pid != NO_PARENT)
+    { // parent sleeps in execute until this child halts
+        get_cur_PCB()->state = TASK_WAITING;
+        get_cur_PCB()->active = 0; // Only changed these because the review slides said to
+    }
+
+    sched_set_current(new_pcb_ptr);
+    screen_select(terminal);
+
+    loadPagingDirectory((unsigned int *)new_pcb_ptr->cr3); // create_process already mapped everything in it
 
     /* Set up old stack and eip */
     tss.ss0 = KERNEL_DS;
-    tss.esp0 = addr_8MB - (cur_pid * size_8kb) - 4; // kernel mode stack pointer
+    tss.esp0 = new_pcb_ptr->esp0; // kernel mode stack pointer
 
     register uint32_t saved_ebp asm("ebp"); // saves the ebp and esp
     register uint32_t saved_esp asm("esp");
@@ -320,37 +493,307 @@ int32_t sys_execute(const uint8_t *command)
     new_pcb_ptr->saved_ebp = saved_ebp;
     /* Go to user mode */
     // will need to set up iret in asm
-    iret_setup(cmd_addr); // calls the iret assembly to jump to next process
+    iret_setup(new_pcb_ptr->entry); // calls the iret assembly to jump to next process
 
     return 0;
 }
 
-/* TLB */
+/* void process_start()
+ *  input   : none
+ *  output  : none
+ *  return  : never returns
+ *  Description : first thing a spawned process runs, scheduling() context switches into it the first
+ *                time it is picked. switch_process has already loaded its pid, pages and TSS.
+ */
+static void process_start()
+{
+    iret_setup(get_cur_PCB()->entry);
+}
+
+/* void process_ready (pcb_t* new_pcb_ptr)
+ *  input   : a process from create_process
+ *  output  : the process waits in the ready queue
+ *  return  : nothing
+ *  Description : sets up its kernel stack the way context_switch leaves a stack, returning
+ *                into process_start. Called with interrupts off.
+ */
+static void process_ready(pcb_t *new_pcb_ptr)
+{
+    uint32_t *stack = (uint32_t *)(new_pcb_ptr->esp0 & ~0x3);
 
-/* void flush_TLB ()
- *  input   : nothing
+    *(--stack) = (uint32_t)process_start; // context_switch's ret
+    *(--stack) = 0;                       // ebp, edi, esi, ebx popped by context_switch
+    *(--stack) = 0;
+    *(--stack) = 0;
+    *(--stack) = 0;
+    new_pcb_ptr->sched_esp = (uint32_t)stack;
+    new_pcb_ptr->sched_ebp = 0;
+
+    sched_enqueue(new_pcb_ptr);
+}
+
+/* int32_t spawn_program (const uint8_t* command, uint8_t terminal)
+ *  input   : pointer to command buffer, terminal of the new process
+ *  output  : the process waits in the ready queue
+ *  return  : pid of the new process, -1 if fail
+ *  Description : starts a base program without switching to it, used for the shells of the
+ *                terminals that are not shown at boot.
+ */
+int32_t spawn_program(const uint8_t *command, uint8_t terminal)
+{
+    uint32_t flags;
+    pcb_t *new_pcb_ptr;
+
+    cli_and_save(flags);
+    new_pcb_ptr = create_process(command, NO_PARENT, terminal);
+    if (new_pcb_ptr == NULL)
+    {
+        restore_flags(flags);
+        return -1;
+    }
+
+    process_ready(new_pcb_ptr);
+    restore_flags(flags);
+    return new_pcb_ptr->pid;
+}
+
+/* int32_t find_pipe_char (const uint8_t* command)
+ *  input   : pointer to command buffer
+ *  output  : none
+ *  return  : index of the first PIPE_CHAR in the command, -1 if there is none
+ *  Description : helper for sys_execute
+ */
+static int32_t find_pipe_char(const uint8_t *command)
+{
+    int32_t i;
+
+    if (command == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < KEY_BUFF_SIZE + 1 && command[i] != '\0' && command[i] != ENTER; i++)
+    {
+        if (command[i] == PIPE_CHAR)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* int32_t execute_pipeline (const uint8_t* command, int32_t parent_pid, uint8_t terminal)
+ *  input   : "left | right" command, pid of the caller, its terminal
+ *  output  : nothing
+ *  return  : status passed to halt by the right side, -1 if fail
+ *  Description : runs both sides with left's stdout going into a pipe that is right's stdin.
+ *                The right side is the child the caller waits for, the left side is spawned
+ *                DETACHED and cleans up after itself. A pipe with no reader makes the left side's
+ *                writes fail, so it still exits if the right side can't start. Only one pipe per
+ *                command, anything after a second PIPE_CHAR goes to the right side as arguments.
+ *                Called with interrupts off.
+ */
+static int32_t execute_pipeline(const uint8_t *command, int32_t parent_pid, uint8_t terminal)
+{
+    uint8_t line[KEY_BUFF_SIZE + 2]; // command up to the pipe, then the rest
+    int32_t split = find_pipe_char(command);
+    int32_t i;
+    const uint8_t *right;
+    pcb_t *left_pcb;
+    pcb_t *right_pcb;
+    pipe_t *pipe;
+
+    for (i = 0; i < split; i++)
+    {
+        line[i] = command[i];
+    }
+    while (i > 0 && line[i - 1] == ' ')
+    { // create_process would take trailing spaces as an argument
+        i--;
+    }
+    line[i] = '\0';
+    right = command + split + 1;
+    while (*right == ' ')
+    {
+        right++;
+    }
+
+    pipe = pipe_create();
+    if (pipe == NULL)
+    {
+        return -1;
+    }
+
+    left_pcb = create_process(line, DETACHED, terminal);
+    if (left_pcb == NULL)
+    {
+        pipe_destroy(pipe);
+        return -1;
+    }
+    pipe_open_write(&left_pcb->file_descriptor[1], pipe);
+    process_ready(left_pcb);
+
+    right_pcb = create_process(right, parent_pid, terminal);
+    if (right_pcb == NULL)
+    {
+        return -1;
+    }
+    pipe_open_read(&right_pcb->file_descriptor[0], pipe);
+
+    return run_process(right_pcb, parent_pid, terminal);
+}
+
+/* void map_user(int pid)
+ *  input   : pid of a process being created
  *  output  : nothing
  *  return  : nothing
- *  Description : causes the x86 system to flush cr3 and resets cr3
+ *  Description : maps the 128MB user page in the process's own directory, either its 4KB page table
+ *                (DEMAND_PAGED_EXEC) or its whole 4MB physical frame. Done once, the mapping stays
+ *                until the directory is freed in halt.
  */
-void flush_TLB()
-{ // moving cr3 isntantly flushes cr3, sets cr3 to itself
-    asm volatile("                 \n\
-            movl    %cr3, %edx      \n\
-            movl    %edx, %cr3      \n\
-            ");
+void map_user(int pid)
+{
+    pcb_t *pcb = (pcb_t *)(addr_8MB - (size_8kb * (pid + 1)));
+
+#ifdef DEMAND_PAGED_EXEC
+    map_table((page_dir_t *)pcb->cr3, USER_SPACE, user_page_tables[pid]);
+#else
+    map((page_dir_t *)pcb->cr3, (void *)USER_SPACE, (void *)pcb->user_frame);
+#endif
+}
+
+/* void share_program_pages(int pid, uint32_t inode, uint32_t length)
+ *  input   : pid: process being set up, inode: program image, length: image length in bytes
+ *  output  : full 4KB pages of the image are mapped read only in the process's page table
+ *  return  : nothing
+ *  Description : maps every program page that is a whole data block straight to that block in the
+ *                filesystem image, so nothing is copied at load time and every instance of a program
+ *                shares them. The partial last page is left to demand_page_fault. Writes are copy on write.
+ */
+void share_program_pages(int pid, uint32_t inode, uint32_t length)
+{
+#ifdef DEMAND_PAGED_EXEC
+    extent_t *extents;
+    int32_t count, i;
+    uint32_t j, page;
+
+    if (((uint32_t)db_start & (PAGE_SIZE - 1)) != 0)
+    { // data blocks only line up with pages if the module is page aligned
+        return;
+    }
+
+    count = inode_extents(inode, &extents);
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < extents[i].length; j++)
+        {
+            page = extents[i].logical + j;
+            if ((page + 1) * PAGE_SIZE > length || PROGRAM_IMG + page * PAGE_SIZE >= USER_SPACE + _4MB)
+            { // runs are in file order, every page after this one is partial or past the user page
+                return;
+            }
+            map_page(user_page_tables[pid], PROGRAM_IMG + page * PAGE_SIZE, (uint32_t)&db_start[(extents[i].physical + j) * BLOCK_SIZE], 0);
+        }
+    }
+#endif
+}
+
+/* int32_t demand_page_fault(uint32_t addr, uint32_t error)
+ *  input   : addr: faulting address from cr2, error: page fault error code
+ *  output  : the page holding addr is mapped and filled in
+ *  return  : 0 if the fault was handled, -1 if it is a real page fault
+ *  Description : called by Page_fault. A not present user page is mapped to its spot in the
+ *                process's 4MB physical frame, then gets the program bytes that fall in that
+ *                page and zeroes for the rest (bss and stack). A write to a read only page shared
+ *                from the filesystem image copies it into the same private spot first.
+ */
+int32_t demand_page_fault(uint32_t addr, uint32_t error)
+{
+#ifdef DEMAND_PAGED_EXEC
+    pcb_t *pcb = get_cur_PCB();
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    uint32_t private_page = pcb->user_frame + (page - USER_SPACE);
+    paging_table_t *entry = &user_page_tables[pcb->pid][(page >> TABLE_SHIFT) & TABLE_MASK];
+    uint32_t shared_page;
+    int32_t count = 0;
+
+    if (num_processes == 0 || addr < USER_SPACE || addr >= USER_SPACE + _4MB)
+    { // faults outside the user page are real faults
+        return -1;
+    }
+
+    if (error & PF_PRESENT)
+    { // only writes to shared read only pages are handled
+        if (!(error & PF_WRITE) || entry->RW)
+        {
+            return -1;
+        }
+        shared_page = entry->index_31_12 << TABLE_SHIFT;
+        map_page(user_page_tables[pcb->pid], page, private_page, 1);
+        tlb_flush_page(page); // drop the read only translation
+        memcpy((uint8_t *)page, (uint8_t *)shared_page, PAGE_SIZE);
+        return 0;
+    }
+
+    map_page(user_page_tables[pcb->pid], page, private_page, 1);
+
+    if (page >= PROGRAM_IMG)
+    { // program image starts on a page boundary, so page offsets are file offsets
+        count = read_data(pcb->exe_inode, page - PROGRAM_IMG, (uint8_t *)page, PAGE_SIZE);
+        if (count < 0)
+        {
+            count = 0;
+        }
+    }
+    memset((uint8_t *)page + count, 0, PAGE_SIZE - count);
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* void switch_process(int pid)
+ *  input   : pid of the process the scheduler is switching to
+ *  output  : nothing
+ *  return  : nothing
+ *  Description : makes pid the current process for the cpu:
+ *                TSS esp0 and its CR3, which holds all of its mappings. The scheduler switches kernel stacks after this.
+ */
+void switch_process(int pid)
+{
+    pcb_t *next = (pcb_t *)(addr_8MB - (size_8kb * (pid + 1)));
+
+    tss.ss0 = KERNEL_DS;
+    tss.esp0 = next->esp0;
+
+    screen_select(next->terminal);
+    loadPagingDirectory((unsigned int *)next->cr3); // global kernel pages stay in the TLB
+}
+
+/* void vidmap_update(int t)
+ *  input   : t: a terminal
+ *  output  : VID_MEM_ADDR in the terminal's vidmap table maps the terminal's page
+ *  return  : nothing
+ *  Description : a terminal's page is video memory while it is shown and its backing page otherwise.
+ *                Every process on the terminal that called vidmap points at this table, so one entry
+ *                changes on a terminal switch. Flushes the one page.
+ */
+void vidmap_update(int t)
+{
+    map_page(vidmap_tables[t], VID_MEM_ADDR, terminal_video(t), 1);
+    tlb_flush_page(VID_MEM_ADDR);
 }
 
 /* Paging Helper */
 // use the map helper function
 
-/* void map(void * vaddr, void * paddr)
- *  input   : pointer to virtual and physical memory address
+/* void map(page_dir_t *dir, void * vaddr, void * paddr)
+ *  input   : page directory to change, pointer to virtual and physical memory address
  *  output  : nothing
  *  return  : nothing
  *  Description : maps the virtual memory to physical memory in paging directory.
  */
-void map(void *vaddr, void *paddr)
+void map(page_dir_t *dir, void *vaddr, void *paddr)
 {
     if ((uint32_t)vaddr < 0 || (uint32_t)paddr < 0)
     { // sanity check
@@ -361,32 +804,32 @@ void map(void *vaddr, void *paddr)
     if (pageDirIdx == USER_PAGE_DIR_IDX)
     {
         // setting page directory at 128 MB virtual address
-        paging_directory[pageDirIdx].P = 1;
-        paging_directory[pageDirIdx].RW = 1;
-        paging_directory[pageDirIdx].US = 1;
-        paging_directory[pageDirIdx].PWT = 0;
-        paging_directory[pageDirIdx].PCD = 0;
-        paging_directory[pageDirIdx].A = 0;
-        paging_directory[pageDirIdx].avl = 0;
-        paging_directory[pageDirIdx].PS = 1;
-        paging_directory[pageDirIdx].AVL = 0;
-        paging_directory[pageDirIdx].G = 0;
-        paging_directory[pageDirIdx].index_31_12 = (uint32_t)paddr >> 12;
+        dir[pageDirIdx].P = 1;
+        dir[pageDirIdx].RW = 1;
+        dir[pageDirIdx].US = 1;
+        dir[pageDirIdx].PWT = 0;
+        dir[pageDirIdx].PCD = 0;
+        dir[pageDirIdx].A = 0;
+        dir[pageDirIdx].avl = 0;
+        dir[pageDirIdx].PS = 1;
+        dir[pageDirIdx].AVL = 0;
+        dir[pageDirIdx].G = 0;
+        dir[pageDirIdx].index_31_12 = (uint32_t)paddr >> 12;
     }
     else
     {
         // setting page directory for video memory page
-        paging_directory[pageDirIdx].P = 1;
-        paging_directory[pageDirIdx].RW = 1;
-        paging_directory[pageDirIdx].US = 1;
-        paging_directory[pageDirIdx].PWT = 0;
-        paging_directory[pageDirIdx].PCD = 0;
-        paging_directory[pageDirIdx].A = 0;
-        paging_directory[pageDirIdx].avl = 0;
-        paging_directory[pageDirIdx].PS = 1;
-        paging_directory[pageDirIdx].AVL = 0;
-        paging_directory[pageDirIdx].G = 0;
-        paging_directory[pageDirIdx].index_31_12 = 0; // physical page starts at 0
+        dir[pageDirIdx].P = 1;
+        dir[pageDirIdx].RW = 1;
+        dir[pageDirIdx].US = 1;
+        dir[pageDirIdx].PWT = 0;
+        dir[pageDirIdx].PCD = 0;
+        dir[pageDirIdx].A = 0;
+        dir[pageDirIdx].avl = 0;
+        dir[pageDirIdx].PS = 1;
+        dir[pageDirIdx].AVL = 0;
+        dir[pageDirIdx].G = 0;
+        dir[pageDirIdx].index_31_12 = 0; // physical page starts at 0
     }
 }
 
@@ -405,16 +848,20 @@ int32_t sys_read(int32_t fd, void *buf, int32_t nbytes)
         return -1;
     } // arg checks
 
-    if (cur_pcb.file_descriptor[fd].flags == 0)
+    fd_t *file = &get_cur_PCB()->file_descriptor[fd];
+    if (file->flags == 0)
     {
         return -1;
     } // Make sure it's been opened
 
     int bytes_read = 0;
 
-    bytes_read = cur_pcb.file_descriptor[fd].file_ops_table_ptr->read(fd, buf, nbytes); // call to read specified by fd
+    bytes_read = file->file_ops_table_ptr->read(file, buf, nbytes); // call to read specified by fd
 
-    cur_pcb.file_descriptor[fd].file_position += bytes_read; // incrementing file position for file read
+    if (bytes_read > 0 && file->file_ops_table_ptr != &reg_dir)
+    { // incrementing file position for file read, directory_read moves a directory's entry index itself
+        file->file_position += bytes_read;
+    }
 
     return bytes_read;
 }
@@ -434,18 +881,256 @@ int32_t sys_write(int32_t fd, const void *buf, int32_t nbytes)
         return -1;
     } // arg checks
 
-    if (cur_pcb.file_descriptor[fd].flags == 0)
+    fd_t *file = &get_cur_PCB()->file_descriptor[fd];
+    if (file->flags == 0)
     {
         return -1;
     } // Make sure it's been opened
 
     int bytes_written = 0;
 
-    bytes_written = cur_pcb.file_descriptor[fd].file_ops_table_ptr->write(fd, buf, nbytes); // call to write specified by fd
+    bytes_written = file->file_ops_table_ptr->write(file, buf, nbytes); // call to write specified by fd
 
     return bytes_written;
 }
 
+/* int32_t iovec_check (const iovec_t* iov, int32_t iovcnt)
+ *  input   : iov: buffers passed to readv or writev, iovcnt: number of them
+ *  output  : none
+ *  return  : 0 if every buffer can be handed to a driver, -1 if not
+ *  Description : helper for sys_readv and sys_writev, same checks sys_read and sys_write make on buf and nbytes
+ */
+static int32_t iovec_check(const iovec_t *iov, int32_t iovcnt)
+{
+    int32_t i;
+
+    if (iov == NULL || iovcnt < 0 || iovcnt > MAX_IOVEC)
+    {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++)
+    {
+        if (iov[i].iov_base == NULL || iov[i].iov_len < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ *  input   : fd: entry in file_descriptor array
+ *            iov: buffers to fill in order
+ *            iovcnt: number of buffers
+ *  output  : none
+ *  return  : total number of bytes read, -1 if nothing could be read
+ *  Description : one kernel entry for several reads. Stops after a buffer comes back short,
+ *                like the end of a file or a terminal line
+ */
+int32_t sys_readv(int32_t fd, const iovec_t *iov, int32_t iovcnt)
+{
+    if (fd < 0 || MAX_FILES <= fd || fd == 1 || iovec_check(iov, iovcnt) == -1)
+    {
+        return -1;
+    } // arg checks, once for the whole batch
+
+    fd_t *file = &get_cur_PCB()->file_descriptor[fd];
+    if (file->flags == 0)
+    {
+        return -1;
+    } // Make sure it's been opened
+
+    int32_t total = 0;
+    int32_t bytes_read;
+    int32_t i;
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        bytes_read = file->file_ops_table_ptr->read(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes_read < 0)
+        {
+            return (total == 0) ? -1 : total;
+        }
+        if (file->file_ops_table_ptr != &reg_dir)
+        { // directory_read moves a directory's entry index itself
+            file->file_position += bytes_read;
+        }
+        total += bytes_read;
+        if (bytes_read < iov[i].iov_len)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/* int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ *  input   : fd: entry in file_descriptor array
+ *            iov: buffers to write in order
+ *            iovcnt: number of buffers
+ *  output  : none
+ *  return  : total number of bytes written, -1 if nothing could be written
+ *  Description : one kernel entry for several writes. For the terminal the screen is held for
+ *                the batch, so output reaches video memory in one flush
+ */
+int32_t sys_writev(int32_t fd, const iovec_t *iov, int32_t iovcnt)
+{
+    if (fd < 1 || MAX_FILES <= fd || iovec_check(iov, iovcnt) == -1)
+    {
+        return -1;
+    } // arg checks, once for the whole batch
+
+    fd_t *file = &get_cur_PCB()->file_descriptor[fd];
+    if (file->flags == 0)
+    {
+        return -1;
+    } // Make sure it's been opened
+
+    int32_t total = 0;
+    int32_t bytes_written;
+    int32_t i;
+    int held = -1;
+
+    if (file->file_ops_table_ptr == &reg_stdout || file->file_ops_table_ptr == &reg_terminal)
+    { // only terminal writes go to the screen, and they never sleep while it is held
+        held = screen_hold();
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        bytes_written = file->file_ops_table_ptr->write(file, iov[i].iov_base, iov[i].iov_len);
+        if (bytes_written < 0)
+        {
+            if (total == 0)
+            {
+                total = -1;
+            }
+            break;
+        }
+        total += bytes_written;
+    }
+    if (held != -1)
+    {
+        screen_release(held);
+    }
+
+    return total;
+}
+
+/* int32_t sys_mmap (int32_t fd)
+ *  input   : fd: entry in file_descriptor array, a regular file
+ *  output  : the whole file is mapped read only in the MMAP_START window
+ *  return  : user address of the file's first byte, -1 for failure
+ *  Description : maps the file's data blocks straight out of the filesystem image, nothing is
+ *                copied. Each run of consecutive blocks is mapped in one go. Bytes past the end of
+ *                the file up to the page boundary are the rest of its last block.
+ */
+int32_t sys_mmap(int32_t fd)
+{
+    pcb_t *pcb = get_cur_PCB();
+    extent_t *extents;
+    int32_t count, i;
+    uint32_t pages, run, base;
+    int32_t length;
+
+    if (fd < 2 || MAX_FILES <= fd || pcb->file_descriptor[fd].flags == 0 ||
+        pcb->file_descriptor[fd].file_ops_table_ptr != &reg_file)
+    {
+        return -1;
+    } // only open regular files
+
+    if (((uint32_t)db_start & (PAGE_SIZE - 1)) != 0)
+    { // data blocks only line up with pages if the module is page aligned
+        return -1;
+    }
+
+    length = get_inode_length(pcb->file_descriptor[fd].inode);
+    pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (length <= 0 || pcb->mmap_next + pages * PAGE_SIZE > _4MB)
+    {
+        return -1;
+    }
+
+    count = inode_extents(pcb->file_descriptor[fd].inode, &extents);
+    if (count <= 0)
+    { // no run list, nothing could be mapped and mmap_next stays put
+        return -1;
+    }
+
+    if (pcb->mmap_table == NULL)
+    { // first mmap, the window gets its page table
+        pcb->mmap_table = (paging_table_t *)frame_alloc_small();
+        if (pcb->mmap_table == NULL)
+        {
+            return -1;
+        }
+        memset(pcb->mmap_table, 0, PAGE_SIZE);
+        map_table((page_dir_t *)pcb->cr3, MMAP_START, pcb->mmap_table);
+    }
+
+    base = MMAP_START + pcb->mmap_next;
+    for (i = 0; i < count; i++)
+    {
+        if (extents[i].logical >= pages)
+        {
+            break;
+        }
+        run = extents[i].length;
+        if (extents[i].logical + run > pages)
+        {
+            run = pages - extents[i].logical;
+        }
+        map_run(pcb->mmap_table, base + extents[i].logical * PAGE_SIZE,
+                (uint32_t)&db_start[extents[i].physical * BLOCK_SIZE], run, 0);
+    }
+    pcb->mmap_next += pages * PAGE_SIZE; // the window only grows, it is dropped at halt
+
+    return base;
+}
+
+/* int32_t sys_pipe (int32_t* fds)
+ *  input   : fds: two entries, filled with the read end then the write end
+ *  output  : a pipe is open on two new file descriptors
+ *  return  : 0 for success, -1 for failure
+ *  Description : pipe system call. Bytes written to fds[1] are read from fds[0] in order
+ */
+int32_t sys_pipe(int32_t *fds)
+{
+    pcb_t *cur_pcb = get_cur_PCB();
+    pipe_t *pipe;
+    int read_fd, write_fd;
+
+    if (fds == NULL)
+    {
+        return -1;
+    }
+
+    read_fd = find_next_fd_index(cur_pcb);
+    if (read_fd == -1)
+    {
+        return -1;
+    }
+    pipe = pipe_create();
+    if (pipe == NULL)
+    {
+        return -1;
+    }
+    pipe_open_read(&cur_pcb->file_descriptor[read_fd], pipe);
+
+    write_fd = find_next_fd_index(cur_pcb);
+    if (write_fd == -1)
+    { // closing the only end frees the pipe
+        sys_close(read_fd);
+        return -1;
+    }
+    pipe_open_write(&cur_pcb->file_descriptor[write_fd], pipe);
+
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
 /* int32_t sys_open (const uint8_t* filename)
  *  input   : filename: name of file we want to open
  *  output  : none
@@ -469,6 +1154,7 @@ int32_t sys_open(const uint8_t *filename)
         return -1;
     }
 
+    pcb_t *cur_pcb = get_cur_PCB();
     int fd_index = find_next_fd_index(cur_pcb);
 
     if (fd_index == -1)
@@ -487,8 +1173,8 @@ int32_t sys_open(const uint8_t *filename)
             return -1;
         }
 
-        cur_pcb.file_descriptor[fd_index].file_ops_table_ptr = &(reg_file); // Set to file type
-        cur_pcb.file_descriptor[fd_index].inode = res;                      // set inode value in file descriptor entry
+        cur_pcb->file_descriptor[fd_index].file_ops_table_ptr = &(reg_file); // Set to file type
+        cur_pcb->file_descriptor[fd_index].inode = res;                      // set inode value in file descriptor entry
         break;
     case 1:
         res = reg_dir.open(filename); // call to directory_open
@@ -498,8 +1184,8 @@ int32_t sys_open(const uint8_t *filename)
             return -1;
         }
 
-        cur_pcb.file_descriptor[fd_index].file_ops_table_ptr = &(reg_dir); // Set to dir type
-        cur_pcb.file_descriptor[fd_index].inode = 0;                       // inode is set to 0 for rtc and directory
+        cur_pcb->file_descriptor[fd_index].file_ops_table_ptr = &(reg_dir); // Set to dir type
+        cur_pcb->file_descriptor[fd_index].inode = 0;                       // inode is set to 0 for rtc and directory
         break;
     case 0:
         res = reg_rtc.open(filename); // call to rtc_open
@@ -509,12 +1195,12 @@ int32_t sys_open(const uint8_t *filename)
             return -1;
         }
 
-        cur_pcb.file_descriptor[fd_index].file_ops_table_ptr = &(reg_rtc); // Set to rtc type
-        cur_pcb.file_descriptor[fd_index].inode = 0;                       // inode is set to 0 for rtc and directory
+        cur_pcb->file_descriptor[fd_index].file_ops_table_ptr = &(reg_rtc); // Set to rtc type
+        cur_pcb->file_descriptor[fd_index].inode = res;                     // rtc keeps its virtual timer in the inode field
         break;
     }
-    cur_pcb.file_descriptor[fd_index].file_position = 0;
-    cur_pcb.file_descriptor[fd_index].flags = 1; // marks entry in file descriptor array occupied
+    cur_pcb->file_descriptor[fd_index].file_position = 0;
+    cur_pcb->file_descriptor[fd_index].flags = 1; // marks entry in file descriptor array occupied
 
     return fd_index;
 }
@@ -531,51 +1217,30 @@ int32_t sys_close(int32_t fd)
     {
         return -1;
     } // can't close stdin or stdout
-    if (cur_pcb.file_descriptor[fd].flags == 0)
+    fd_t *file = &get_cur_PCB()->file_descriptor[fd];
+    if (file->flags == 0)
     {
         return -1;
     }
-    cur_pcb.file_descriptor[fd].flags = 0; // Set fd availability flag to 0
-    cur_pcb.file_descriptor[fd].file_position = 0;
-    cur_pcb.file_descriptor[fd].inode = -1;
-    cur_pcb.file_descriptor[fd].file_ops_table_ptr->close(fd); // call close function for file descriptor
+    file->file_ops_table_ptr->close(file); // call close function for file descriptor, before the fd is cleared
+    file->flags = 0; // Set fd availability flag to 0
+    file->file_position = 0;
+    file->inode = -1;
     return 0;
 }
 
-/* int get_PCB_addr()
- *  input   : none
- *  output  : none
- *  return  : address of current PCB in the form of integer
- *  Description : helper function that gets the PCB address
- */
-int get_PCB_addr()
-{
-    return addr_8MB - (size_8kb * (cur_pid + 1));
-}
-
-/* pcb_t get_cur_PCB
- *  input   : none
- *  output  : none
- *  return  : returns pcb_t object for the current pcb
- *  Description : helper function that gets the current pcb
- */
-pcb_t get_cur_PCB()
-{
-    return cur_pcb;
-}
-
-/* int find_next_fd_index(pcb_t p)
- *  input   : p: a pcb object
+/* int find_next_fd_index(pcb_t *p)
+ *  input   : p: a pcb
  *  output  : index into file descriptor or -1
  *  return  : next avaliable file descriptor
  *  Description : helper function that gets the next avaliable file descriptor
  */
-int find_next_fd_index(pcb_t p)
+int find_next_fd_index(pcb_t *p)
 {
     int i;
     for (i = 2; i < MAX_FILES; i++)
     { // go through file_descriptor and see if any entries are open
-        if (p.file_descriptor[i].flags == 0)
+        if (p->file_descriptor[i].flags == 0)
         {
             return i; // open entry was found
         }
@@ -591,6 +1256,8 @@ int find_next_fd_index(pcb_t p)
  */
 int32_t sys_getargs(uint8_t *buf, int32_t nbytes)
 {
+    pcb_t *cur_pcb = get_cur_PCB();
+
     if (buf == NULL)
     { // null checks
         return -1;
@@ -599,11 +1266,11 @@ int32_t sys_getargs(uint8_t *buf, int32_t nbytes)
     {
         return -1;
     }
-    if (cur_pcb.arg[0] == '\0')
+    if (cur_pcb->arg[0] == '\0')
     {
         return -1;
     }
-    if (cur_pcb.arg_len > KEY_BUFF_SIZE + 1)
+    if (cur_pcb->arg_len > KEY_BUFF_SIZE + 1)
     {
         return -1;
     }
@@ -611,11 +1278,11 @@ int32_t sys_getargs(uint8_t *buf, int32_t nbytes)
     // copying over arg into buf
     for (i = 0; i < nbytes; i++)
     {
-        if (cur_pcb.arg[i] == '\0')
+        if (cur_pcb->arg[i] == '\0')
         {
             break;
         }
-        buf[i] = cur_pcb.arg[i];
+        buf[i] = cur_pcb->arg[i];
     }
     buf[i] = '\0';
 
@@ -639,9 +1306,11 @@ int32_t sys_vidmap(uint8_t **screen_start)
         return -1;
     }
 
-    *screen_start = (uint8_t *)VID_MEM_ADDR;    // set *(screen_start) to virtual address of video memory
-    map((void *)(VID_MEM_DIR), (void *)(0x00)); // physical address of directory where vid mem is located is 0
-    flush_TLB();
+    pcb_t *pcb = get_cur_PCB();
+    *screen_start = (uint8_t *)VID_MEM_ADDR; // set *(screen_start) to virtual address of video memory
+    pcb->vidmap = 1;
+    vidmap_update(pcb->terminal);
+    map_table((page_dir_t *)pcb->cr3, VID_MEM_DIR, vidmap_tables[pcb->terminal]); // stays mapped until halt
 
     return 0;
 }
@@ -649,69 +1318,3 @@ int32_t sys_vidmap(uint8_t **screen_start)
 // CP 5 maybe?
 int32_t sys_set_handler(int32_t signum, void *handler_address) { return -1; }
 int32_t sys_sigreturn(void) { return -1; }
-
-// Layout Scheduling
-void scheduling()
-{
-    cli(); // stop interrupts
-    /* Set next terminal by cycling with main terminal (main + 1) % 3 */
-
-    /* Set next pid with the next main terminal's pid */
-
-    /* Save ebp and esp. Double check position with local variables*/
-
-    /* Update main terminal fields (pid, ebp, esp) */
-    // only if (flag != 0)
-
-    /* For first 3 processes/shells */
-    // if (flag < 3)
-    // set main terminal's eoi flag to 0
-    // set video page
-
-    // if (flag != 0)
-    // copy over B8 to BA+main (* use strncpy for eol)
-    // copy over BA+next to B8
-
-    // set display terminal to the next terminal
-    // set main terminal to the next terminal
-
-    // Increment flag
-    // sys execute shell and return
-
-    /* Update esp and ebp using in line assembly. Use next terminal's saved esp and ebp */
-
-    /* Switch video mapping */
-    // Flush TLB
-
-    // if (next terminal == main terminal) -> break
-    // else if (next terminal == display terminal && main terminal != display terminal)
-    // copy vidmem to 0xBA+main
-    // set video page
-    // remap 0xB8 page to physical mem (page_table[ENTRIES]31_12 = 0xB8)
-
-    // else if (next terminal != display terminal && main terminal == display terminal)
-    // copy vidmem to 0xBA+main
-    // Set inv video page. Same as set video page except 31_12 = (next terminal + 8) << 10
-    // Flush TLB
-    // copy BA+next to vidmem
-    // remap 0xB8 page to physical mem (page_table[ENTRIES]31_12 = ((8+next)*4MB + 184*4KB) / 4KB)
-
-    /* Update pid and main*/
-    // cur pid = next pid
-    // main terminal = next terminal
-
-    /* TSS */
-    // ss0 = KERNEL_DS
-    // esp0 = 8MB - (8KB * cur pid) - 4
-
-    /* To user code */
-    // set page dir 32's 31_12 = (8 + next pid) << 10. Similar to map function
-
-    // Flush TLB
-
-    /* Update cursor with display terminal */
-    // call update_cursor using display terminal
-
-    // send_eoi(0)
-    return;
-}
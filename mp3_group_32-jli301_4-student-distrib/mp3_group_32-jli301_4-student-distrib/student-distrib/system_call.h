@@ -4,6 +4,7 @@
 #ifndef ASM
 
 #include "lib.h"
+#include "fd.h"
 #include "file_system.h"
 #include "file_system_driver.h"
 #include "rtc.h"
@@ -11,8 +12,11 @@
 #include "interrupt_linkage.h"
 #include "paging.h"
 #include "x86_desc.h"
+#include "frame.h"
+#include "slab.h"
 
 #define MAX_FILES 8 // max number of files in file descriptor array
+#define MAX_IOVEC 16 // most buffers one readv or writev takes
 #define addr_8MB 0x800000 // hex value for 8MB addr
 #define _4MB    0x400000 // hex value for 4 MB value
 #define size_8kb 0x2000 // hex value for 8 kB value
@@ -22,29 +26,27 @@
 #define PROGRAM_IMG 0x08048000 // hex value for address of program image
 #define VID_MEM_DIR 0x8400000 // location of page directory where virtual video mem is located
 #define VID_MEM_ADDR 0x84b8000 // virtual location of video mem
-#define OVER_MAX_PROCESSES 2 // Max number of process that can be run, will be 6 for checkpoint 5
+#define MMAP_START 0x8800000 // 4MB window files are mapped into, the directory entry after vidmap's
+#define OVER_MAX_PROCESSES 16 // pcb/kernel stack slots, free 4MB frames usually run out first
+#define NO_PARENT 0xFF // parent_pid of a base shell
+#define DETACHED 0xFE // parent_pid of the left side of a pipeline, nothing waits for it
+#define PIPE_CHAR '|' // splits a command into a pipeline
+#define DEMAND_PAGED_EXEC // map program pages on first touch instead of copying the image in sys_execute
+#define SHARED_EXEC_PAGES // map whole program pages read only straight from the filesystem image, copy on write (needs DEMAND_PAGED_EXEC)
+#define PF_PRESENT 0x1 // page fault error code bit, set when the page was present (protection fault)
+#define PF_WRITE 0x2 // page fault error code bit, set when the access was a write
 
-// struct for a file_operation table
-typedef struct file_operations {
-    int32_t (*open)(const uint8_t* file_name);
-    int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
-    int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
-    int32_t (*close)(int32_t fd);
-} file_operations_t;
-
-// struct for a file descriptor table
-typedef struct fd {
-    file_operations_t* file_ops_table_ptr;
-    uint32_t inode;
-    uint32_t file_position;
-    uint32_t flags;
-} fd_t;
+// one buffer of a readv or writev
+typedef struct iovec {
+    void* iov_base;
+    int32_t iov_len;
+} iovec_t;
 
 // struct for a pcb block
 typedef struct pcb {
     uint8_t pid;
     uint8_t parent_pid;
-    fd_t file_descriptor[MAX_FILES];
+    fd_t* file_descriptor; // MAX_FILES entries from fd_table_cache
     uint8_t file[MAX_NAME_LENGTH];
     uint8_t arg[KEY_BUFF_SIZE];
     uint8_t file_len;
@@ -52,6 +54,20 @@ typedef struct pcb {
     uint32_t saved_esp;
     uint32_t saved_ebp;
     uint8_t active;
+    uint32_t exe_inode; // program image, read in page by page when DEMAND_PAGED_EXEC is set
+    uint32_t exe_length;
+    uint32_t sched_esp; // kernel esp and ebp saved by the scheduler when switched out
+    uint32_t sched_ebp;
+    uint32_t esp0;      // kernel stack top, loaded into the TSS when switched in
+    uint32_t cr3;       // page directory from page_dir_create, loaded when switched in
+    uint8_t state;      // TASK_* in scheduler.h
+    struct pcb* next_ready; // ready queue link
+    uint8_t terminal;   // terminal the process reads from and writes to
+    uint8_t vidmap;     // set once the process called vidmap
+    uint32_t entry;     // program entry point, used to start spawned processes
+    uint32_t user_frame; // physical 4MB frame behind the process's user page
+    paging_table_t* mmap_table; // page table of the MMAP_START window, NULL until the first mmap
+    uint32_t mmap_next; // offset of the next free page in the window
 } pcb_t;
 
 int32_t sys_halt (uint8_t status);
@@ -64,14 +80,36 @@ int32_t sys_getargs (uint8_t* buf, int32_t nbytes);
 int32_t sys_vidmap (uint8_t** screen_start);
 int32_t sys_set_handler (int32_t signum, void* handler_address);
 int32_t sys_sigreturn (void);
+int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t sys_mmap (int32_t fd);
+int32_t sys_pipe (int32_t* fds);
+int32_t execute_program (const uint8_t* command, int32_t parent_pid, uint8_t terminal);
+int32_t spawn_program (const uint8_t* command, uint8_t terminal);
 
 void file_desc_init();
 int32_t bad_call();
-int get_PCB_addr();
-pcb_t get_cur_PCB();
-int find_next_fd_index(pcb_t p);
-void map(void* vaddr, void* paddr);
-void flush_TLB();
+int find_next_fd_index(pcb_t *p);
+void map(page_dir_t* dir, void* vaddr, void* paddr);
+void map_user(int pid);
+void switch_process(int pid);
+void vidmap_update(int t);
+int32_t demand_page_fault(uint32_t addr, uint32_t error);
+void share_program_pages(int pid, uint32_t inode, uint32_t length);
+
+/* pcb_t* get_cur_PCB()
+ *  input   : none
+ *  output  : none
+ *  return  : pcb of the process whose kernel stack we are on
+ *  Description : every pcb sits at the bottom of its 8KB kernel stack slot (the boot stack is one too),
+ *                so rounding esp down finds it without a global that has to be kept in step
+ */
+static inline pcb_t *get_cur_PCB()
+{
+    uint32_t esp;
+    asm volatile("movl %%esp, %0" : "=r"(esp));
+    return (pcb_t *)(esp & ~(size_8kb - 1));
+}
 
 extern void iret_setup(uint32_t eip);
 extern void ret_halt(uint32_t eax, uint32_t ebp, uint32_t esp);
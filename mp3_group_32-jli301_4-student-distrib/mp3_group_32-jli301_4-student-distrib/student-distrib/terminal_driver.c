@@ -2,72 +2,172 @@
  * vim:ts=4 noexpandtab
  */
 
-#include "keyboard.h"
+#include "terminal_driver.h"
 #include "lib.h"
 #include "i8259.h"
+#include "scheduler.h"
 
 #define OS_SIZE 6 // size of "391OS>"
 
-int start; // global variables for start and end
-int end;
+/* Line discipline. Each terminal has its own ring of entered lines. keyboard_input is the only writer
+ * of head and terminal_read the only writer of tail, so a ring needs no lock. Whole lines ending in
+ * '\n' are published at once, any bytes between tail and head make up at least one complete line. */
+typedef struct terminal {
+    uint8_t line_ring[LINE_RING_SIZE];
+    volatile uint32_t head;             // next byte to write, only moves forward
+    volatile uint32_t tail;             // next byte to read, only moves forward
+    wait_queue_t line_wait;             // processes blocked in terminal_read
+} terminal_t;
+
+static terminal_t terminals[NUM_TERMINALS];
+static int shown_terminal = 0;          // terminal in video memory, gets the keyboard
+
+/* function     : line_push
+ * input        : line, len - characters typed before enter
+ * output       : the line and a '\n' are queued for terminal_read on the shown terminal
+ * Description  : Called by the keyboard handler when enter is pressed. Wakes a waiting terminal_read
+ * return       : 0 on success, -1 if the ring is too full and the line is dropped
+ */
+int32_t line_push(const uint8_t* line, int32_t len){
+    terminal_t* term = &terminals[shown_terminal];
+    uint32_t head = term->head;
+    int32_t i;
+
+    if (len + 1 > LINE_RING_SIZE - (int32_t)(head - term->tail)) { return -1; }
+
+    for (i = 0; i < len; i++) {
+        term->line_ring[(head + i) & LINE_RING_MASK] = line[i];
+    }
+    term->line_ring[(head + len) & LINE_RING_MASK] = '\n';
+    asm volatile ("" : : : "memory"); // the bytes must be in the ring before the reader sees the new head
+    term->head = head + len + 1;
+
+    wake_up(&term->line_wait);
+    return 0;
+}
+
+/* function     : terminal_shown
+ * input        : nothing
+ * output       : nothing
+ * Description  : Terminal currently in video memory
+ * return       : its index
+ */
+int terminal_shown(void){
+    return shown_terminal;
+}
+
+/* function     : terminal_video
+ * input        : t - terminal
+ * output       : nothing
+ * Description  : Physical page holding the terminal's text, video memory while it is shown and its
+ *                backing page otherwise
+ * return       : page address
+ */
+uint32_t terminal_video(int t){
+    return (t == shown_terminal) ? VIDEO : TERMINAL_BACKING(t);
+}
+
+/* function     : terminals_init
+ * input        : nothing
+ * output       : nothing
+ * Description  : Points every terminal's screen at its video page and blanks the ones not shown.
+ *                Needs the backing pages mapped by paging_init
+ * return       : nothing
+ */
+void terminals_init(void){
+    int t;
+    for (t = 0; t < NUM_TERMINALS; t++) {
+        screen_set_video(t, (char*)terminal_video(t));
+        if (t != shown_terminal) {
+            screen_select(t);
+            clear();
+        }
+    }
+    screen_select(shown_terminal);
+}
+
+/* function     : terminal_switch
+ * input        : t - terminal to show
+ * output       : video memory holds terminal t
+ * Description  : Alt+F1..F3. Saves what is on screen (text and anything drawn through vidmap) to the old
+ *                terminal's backing page, copies the new one in, and from then on each terminal's writes
+ *                go straight to its own page. Called from the keyboard handler with interrupts off
+ * return       : nothing
+ */
+void terminal_switch(int t){
+    int old = shown_terminal;
+
+    if (t == old || t < 0 || t >= NUM_TERMINALS) { return; }
+
+    flush_screen(); // both pages are up to date before they are swapped
+    memcpy((void*)TERMINAL_BACKING(old), (void*)VIDEO, PAGE_SIZE);
+    memcpy((void*)VIDEO, (void*)TERMINAL_BACKING(t), PAGE_SIZE);
+
+    shown_terminal = t;
+    screen_set_video(old, (char*)TERMINAL_BACKING(old));
+    screen_set_video(t, (char*)VIDEO);
+    screen_show(t);
+    keyboard_switch_line(old, t);
+    vidmap_update(old); // vidmap'd processes on both terminals see the swap
+    vidmap_update(t);
+}
 
 /* function     : terminal_init
  * input        : nothing
  * output       : nothing
- * Description  : Clears screen and initializes terminal global variables
+ * Description  : Clears screen
  * return       : nothing
  */
 void terminal_init(void){
-    clear(); // clear screen and initializes start/end to 0
-    start = 0;
-    end = 0;
+    clear(); // clear screen
 }
 
-/* function     : terminal_rad
- * input        : fd, buf, nbytes
+/* function     : terminal_read
+ * input        : file, buf, nbytes
  * output       : passed in buffer is filled
- * Description  : Reads keyboard buffer and fills passed in buffer
+ * Description  : Sleeps until a line has been entered, then copies it without the '\n'. Characters past
+ *                nbytes are dropped with the rest of the line
  * return       : number of bytes read
  */
-int terminal_read(int32_t fd, void* buf, int32_t nbytes){
-    int i;
-    int endflag = 0; // indicates end of buffer
-    if (fd != 0) { return -1;} // null checks for parameter
+int terminal_read(fd_t* file, void* buf, int32_t nbytes){
+    uint32_t flags;
+    uint32_t tail;
+    uint8_t c;
+    int32_t count = 0;
+    terminal_t* term;
     if (buf == NULL) { return -1; }
 
-    while(1){
-        // cli();
-        for (i = 0; i < keyIndex; i++) { 
-            if (keyIndex <= KEY_BUFF_SIZE && keyboard_buffer[i] != '\n') // checking if enter key was pressed
-            {
-                ((char*)buf)[i] = keyboard_buffer[i];
-            }
-            if (keyboard_buffer[i] == '\n') {
-                end = i;
-                endflag = 1;
-                break;
-            }
+    term = &terminals[(sched_current() == NULL) ? shown_terminal : sched_current()->terminal]; // reads its own terminal's lines
+
+    cli_and_save(flags);
+    while (term->head == term->tail) { // no complete line yet
+        sleep_on(&term->line_wait);
+    }
+    restore_flags(flags);
+
+    tail = term->tail;
+    while (1) {
+        c = term->line_ring[tail & LINE_RING_MASK];
+        tail++;
+        if (c == '\n') { break; }
+        if (count < nbytes) {
+            ((uint8_t*)buf)[count++] = c;
         }
-        
-        // sti();
-        if (endflag) {break;} 
     }
-    int ret = end; // set ret and start after loop
-    start += ret + 1;
-    // resetBuff();
-    return ret;
+    asm volatile ("" : : : "memory"); // done reading the line before the space is handed back
+    term->tail = tail;
 
+    return count;
 }
 
 /* function     : terminal_write
- * input        : fd, buf, nbytes
+ * input        : file, buf, nbytes
  * output       : buffer is echoed in terminal
  * Description  : Takes in buffer and writes it to the screen
  * return       : number of bytes written
  */
-int terminal_write(int32_t fd, const void* buf, int32_t nbytes){
+int terminal_write(fd_t* file, const void* buf, int32_t nbytes){
     int i;
-    if (fd != 1) { return -1;} // null checks for parameters
     if (buf == NULL) { return -1; }
 
     char OS_BUF[OS_SIZE] = "391OS>"; // 391OS> buf
@@ -84,8 +184,8 @@ int terminal_write(int32_t fd, const void* buf, int32_t nbytes){
     for (i = 0; i < nbytes; i++){ // write buf to screen
         putc((uint8_t) ((char*)buf)[i]);
     }
+    flush_screen(); // one copy to video memory and one cursor update for the whole write
 
-    resetBuff(); // reset the keyboard buffer
     return nbytes;
 }
 
@@ -102,14 +202,12 @@ int terminal_open(const uint8_t* filename){
 }
 
 /* function     : terminal_close
- * input        : fd
+ * input        : file
  * output       : 0
  * Description  : Closes terminal and resets keyboard buffer
  * return       : 0
  */
-int terminal_close(int32_t fd){
-    if(fd < 0)
-        return -1;
+int terminal_close(fd_t* file){
     resetBuff(); // resets keyboard buffer
     return 0;
 }
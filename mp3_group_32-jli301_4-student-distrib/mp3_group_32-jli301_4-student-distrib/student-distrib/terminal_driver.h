@@ -7,11 +7,22 @@
 
 #include "types.h"
 #include "keyboard.h"
+#include "fd.h"
+
+#define LINE_RING_SIZE  512                         // entered lines waiting for terminal_read, power of 2
+#define LINE_RING_MASK  (LINE_RING_SIZE - 1)
+#define VIDEO           0xB8000                     // video memory
+#define TERMINAL_BACKING(t) (0xBA000 + (t) * 0x1000) // page a terminal's text lives in while it is not shown
 
 void terminal_init(void);
-int terminal_read(int32_t fd, void* buf, int32_t nbytes);
-int terminal_write(int32_t fd, const void* buf, int32_t nbytes);
+int terminal_read(fd_t* file, void* buf, int32_t nbytes);
+int terminal_write(fd_t* file, const void* buf, int32_t nbytes);
 int terminal_open(const uint8_t* filename);
-int terminal_close(int32_t fd);
+int terminal_close(fd_t* file);
+int32_t line_push(const uint8_t* line, int32_t len);
+int terminal_shown(void);
+uint32_t terminal_video(int t);
+void terminals_init(void);
+void terminal_switch(int t);
 
 #endif /* _TERMINAL_H */
@@ -9,6 +9,10 @@
 #include "file_system.h"
 #include "file_system_driver.h"
 #include "terminal_driver.h"
+#include "pit.h"
+#include "frame.h"
+#include "slab.h"
+#include "pipe.h"
 
 #define PASS 1
 #define FAIL 0
@@ -25,6 +29,14 @@ static inline void assertion_failure(){
 	asm volatile("int $15");
 }
 
+/* Reads the low 32 bits of the time stamp counter, enough for
+   timing deltas of a few seconds */
+static inline uint32_t read_tsc(){
+	uint32_t low, high;
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	return low;
+}
+
 
 /* Checkpoint 1 tests */
 
@@ -637,10 +649,10 @@ int terminal_driver_test(){
 
 	while (1) {				// When not equal
 		// memset(buf, 0, 128);
-		read = terminal_read(0, buf, 128); // 128 is length of buffer
+		read = terminal_read(&get_cur_PCB()->file_descriptor[0], buf, 128); // 128 is length of buffer
 		read_count += read;
-		if (strncmp((int8_t*)keyboard_buffer, "quit", 4) == 0) {break;} // check 4 bytes
-		write = terminal_write(0, buf, read);
+		if (strncmp((int8_t*)buf, "quit", 4) == 0) {break;} // check 4 bytes of the line just read
+		write = terminal_write(&get_cur_PCB()->file_descriptor[1], buf, read);
 		write_count += write_count;
 	}
 	printf("write = %d, read = %d", write_count, read_count);
@@ -664,18 +676,18 @@ int rtc_frequency_cycle_test(){
 	clear();
 	uint32_t i = 2;
 	uint32_t j = 0;
-	int32_t fd;
+	fd_t fd;
 	int32_t checkpass = 0;
 
-	fd = rtc_open(NULL);
+	fd.inode = rtc_open(NULL);
 
 	for(i = 2; i <= 1024; i *= 2){ // 1024 is max freq to be tested
 		printf("Testing %d Hz\n", i);
-		checkpass += rtc_write(0, &i, sizeof(int32_t));
+		checkpass += rtc_write(&fd, &i, sizeof(int32_t));
 		//rtc_change_freq(i);
 		
 		for(j = 0; j <= i; j++){
-			checkpass += rtc_read(fd, NULL, sizeof(int32_t));
+			checkpass += rtc_read(&fd, NULL, sizeof(int32_t));
 			printf("8");
 		}
 		printf("\n");
@@ -689,11 +701,878 @@ int rtc_frequency_cycle_test(){
 
 }
 
+/* rtc_per_fd_rate_test
+ * 
+ * two rtc fds keep their own virtual frequency
+ * Inputs: None
+ * Outputs: PASS/FAIL if the 64Hz fd keeps its rate after the other is set to 2Hz
+ * Side Effects: None
+ * Coverage: RTC timer wheel
+ * Files: rtc.c, pit.c
+ */
+int rtc_per_fd_rate_test(){
+	TEST_HEADER;
+	fd_t fast, slow;
+	int32_t fast_freq = 64;		// 32 reads at 64Hz is half a second
+	int32_t slow_freq = 2;
+	uint32_t start_ticks, elapsed;
+	int i;
+	int result = PASS;
+
+	fast.inode = rtc_open(NULL);
+	slow.inode = rtc_open(NULL);
+	if(fast.inode == -1 || slow.inode == -1 || fast.inode == slow.inode){
+		return FAIL;
+	}
+	rtc_write(&fast, &fast_freq, sizeof(int32_t));
+	rtc_write(&slow, &slow_freq, sizeof(int32_t));
+
+	rtc_read(&fast, NULL, 0);	// line up with the fast timer first
+	start_ticks = pit_ticks();
+	for(i = 0; i < 32; i++){
+		rtc_read(&fast, NULL, 0);
+	}
+	elapsed = pit_ticks() - start_ticks;
+	printf("32 reads at 64Hz took %d PIT ticks\n", elapsed);
+	if(elapsed < PIT_HZ / 2 - 5 || elapsed > PIT_HZ / 2 + 5){	// a few ticks of slack for the PIT
+		result = FAIL;
+	}
+
+	rtc_close(&fast);
+	rtc_close(&slow);
+	return result;
+}
+
 
 /* Checkpoint 3 tests */
 /* Checkpoint 4 tests */
+
+/* kernel_large_page_test
+ * 
+ * the kernel and its boot structures sit in the one cached 4MB page and the 4KB table only maps VGA
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: paging_init
+ * Files: paging.c
+ */
+int kernel_large_page_test(){
+	TEST_HEADER;
+	uint32_t boot[] = {(uint32_t)&gdt_ptr, (uint32_t)idt, (uint32_t)&tss, (uint32_t)paging_directory, (uint32_t)paging_table};
+	int i;
+	int result = PASS;
+
+	if(!paging_directory[1].P || !paging_directory[1].PS || paging_directory[1].PCD || paging_directory[1].PWT){
+		result = FAIL;
+	}
+	for(i = 0; i < sizeof(boot) / sizeof(boot[0]); i++){
+		if((boot[i] >> DIR_SHIFT) != 1){
+			result = FAIL;
+		}
+	}
+	for(i = 0; i < ENTRIES; i++){
+		if(paging_table[i].P && !(i == VID_START || (i >= VID_BACKING_START && i < VID_BACKING_START + VID_BACKING_PAGES))){
+			result = FAIL;
+		}
+	}
+	if(paging_table[0].P){		// NULL guard
+		result = FAIL;
+	}
+	return result;
+}
+
+/* page_dir_test
+ * 
+ * a new process directory shares the kernel's entries and maps nothing else
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: page_dir_create, page_dir_free
+ * Files: paging.c
+ */
+int page_dir_test(){
+	TEST_HEADER;
+	uint32_t frames = frame_free_small_count();
+	page_dir_t* dir = page_dir_create();
+	int i;
+	int result = PASS;
+
+	if(dir == NULL || ((uint32_t)dir & (PAGE_SIZE - 1))){
+		return FAIL;
+	}
+	for(i = 0; i < ENTRIES; i++){
+		if(i < KERNEL_DIR_ENTRIES ? dir[i].val != paging_directory[i].val : dir[i].P){
+			result = FAIL;
+		}
+	}
+	page_dir_free(dir);
+	if(frame_free_small_count() != frames){
+		result = FAIL;
+	}
+	return result;
+}
+
+/* global_pages_test
+ * 
+ * only mappings every process shares are global, and PGE is on when the cpu has it
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: paging_init, enable_global_pages
+ * Files: paging.c
+ */
+int global_pages_test(){
+	TEST_HEADER;
+	uint32_t eax, ebx, ecx, edx, cr4;
+	int i;
+	int result = PASS;
+
+	cpuid(1, eax, ebx, ecx, edx);
+	asm volatile("movl %%cr4, %0" : "=r"(cr4));
+	if(!!(edx & CPUID_PGE) != !!(cr4 & CR4_PGE) || !!(cr4 & CR4_PGE) != global_pages_enabled){
+		result = FAIL;
+	}
+
+	if(!paging_directory[1].G){		// kernel
+		result = FAIL;
+	}
+	for(i = 0; i < ENTRIES; i++){
+		if(i != 1 && paging_directory[i].P && paging_directory[i].PS && paging_directory[i].G){
+			result = FAIL;		// a 4MB page someone else maps differently
+		}
+		if(paging_table[i].G && !(i == VID_START || (i >= VID_BACKING_START && i < VID_BACKING_START + VID_BACKING_PAGES))){
+			result = FAIL;
+		}
+	}
+	if(!paging_table[VID_START].G){
+		result = FAIL;
+	}
+	return result;
+}
+
+#define PIPE_TEST_CHUNK	3000	// not a divisor of PIPE_SIZE, so the second write wraps the ring
+
+/* pipe_test
+ * 
+ * bytes come out of a pipe in order across the ring's wrap and the pipe is freed on close
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: sys_pipe, pipe_read, pipe_write, pipe_read_close, pipe_write_close
+ * Files: pipe.c, system_call.c
+ */
+int pipe_test(){
+	TEST_HEADER;
+	static uint8_t in[PIPE_TEST_CHUNK];
+	static uint8_t out[PIPE_TEST_CHUNK];
+	uint32_t frames;
+	int32_t fds[2];
+	int32_t i, round;
+	int result = PASS;
+
+	if(sys_pipe(fds) == -1){
+		return FAIL;
+	}
+	frames = frame_free_small_count();		// the pipe cache may keep its emptied slab as a spare, so only count the ring
+	for(round = 0; round < 2; round++){
+		for(i = 0; i < PIPE_TEST_CHUNK; i++){
+			in[i] = (uint8_t)(i * 7 + round);
+		}
+		if(sys_write(fds[1], in, PIPE_TEST_CHUNK) != PIPE_TEST_CHUNK){
+			result = FAIL;
+		}
+		if(sys_read(fds[0], out, 1000) != 1000 ||		// two reads, one of them crosses the wrap on round 1
+		   sys_read(fds[0], out + 1000, PIPE_TEST_CHUNK) != PIPE_TEST_CHUNK - 1000){
+			result = FAIL;
+		}
+		for(i = 0; i < PIPE_TEST_CHUNK; i++){
+			if(out[i] != in[i]){
+				result = FAIL;
+			}
+		}
+	}
+	if(sys_read(fds[1], out, 1) != -1 || sys_write(fds[0], in, 1) != -1){		// wrong ends
+		result = FAIL;
+	}
+
+	sys_write(fds[1], in, 10);
+	sys_close(fds[1]);
+	if(sys_read(fds[0], out, PIPE_TEST_CHUNK) != 10 || sys_read(fds[0], out, PIPE_TEST_CHUNK) != 0){	// drained, then end of file
+		result = FAIL;
+	}
+	sys_close(fds[0]);
+
+	if(frame_free_small_count() != frames + 1){		// ring went back
+		result = FAIL;
+	}
+	return result;
+}
+
+/* mmap_test
+ * 
+ * a mapped file reads the same as read_data and each mapping gets its own pages
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the kernel's mmap window is dropped again
+ * Coverage: sys_mmap, map_run
+ * Files: system_call.c, paging.c
+ */
+int mmap_test(){
+	TEST_HEADER;
+	static uint8_t expect[BLOCK_SIZE * 2];
+	pcb_t* pcb = get_cur_PCB();
+	dentry_t dentry;
+	int32_t fd, count, i;
+	uint8_t *first, *second;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"fish", &dentry) == -1){		// spans several blocks
+		return FAIL;
+	}
+	count = read_data(dentry.inode_number, 0, expect, sizeof(expect));
+
+	fd = sys_open((uint8_t*)"fish");
+	first = (uint8_t*)sys_mmap(fd);
+	second = (uint8_t*)sys_mmap(fd);
+	if((int32_t)first == -1 || (int32_t)second == -1 || second <= first || ((uint32_t)first & (PAGE_SIZE - 1))){
+		result = FAIL;
+	}
+	for(i = 0; i < count && result == PASS; i++){
+		if(first[i] != expect[i] || second[i] != expect[i]){
+			result = FAIL;
+		}
+	}
+	if(sys_mmap(0) != -1 || sys_mmap(MAX_FILES) != -1){		// stdin is not a file
+		result = FAIL;
+	}
+	sys_close(fd);
+
+	frame_free_small((uint32_t)pcb->mmap_table);
+	pcb->mmap_table = NULL;
+	pcb->mmap_next = 0;
+	unmap_table((page_dir_t*)pcb->cr3, MMAP_START);
+	flush_TLB();
+	return result;
+}
+
+#define IOV_TEST_SPLIT	100		// first readv buffer, the second gets the rest
+
+/* readv_writev_test
+ * 
+ * readv fills its buffers in order and writev writes every buffer
+ * Inputs: None
+ * Outputs: PASS/FAIL if readv matches read_data over frame0.txt and writev returns the total
+ * Side Effects: Prints two lines
+ * Coverage: sys_readv, sys_writev
+ * Files: system_call.c
+ */
+int readv_writev_test(){
+	TEST_HEADER;
+	static uint8_t first[IOV_TEST_SPLIT], rest[BLOCK_SIZE], expect[IOV_TEST_SPLIT + BLOCK_SIZE];
+	iovec_t iov[3];
+	dentry_t dentry;
+	int32_t fd, count, expect_count, i;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1){
+		return FAIL;
+	}
+	expect_count = read_data(dentry.inode_number, 0, expect, sizeof(expect));
+
+	fd = sys_open((uint8_t*)"frame0.txt");
+	iov[0].iov_base = first;
+	iov[0].iov_len = IOV_TEST_SPLIT;
+	iov[1].iov_base = rest;
+	iov[1].iov_len = BLOCK_SIZE;
+	count = sys_readv(fd, iov, 2);
+	if(count != expect_count){
+		result = FAIL;
+	}
+	for(i = 0; i < count && result == PASS; i++){
+		if(((i < IOV_TEST_SPLIT) ? first[i] : rest[i - IOV_TEST_SPLIT]) != expect[i]){
+			result = FAIL;
+		}
+	}
+	if(sys_readv(fd, iov, 2) != 0){		// whole file was read, position moved with it
+		result = FAIL;
+	}
+	sys_close(fd);
+
+	iov[0].iov_base = "writev ";
+	iov[0].iov_len = 7;
+	iov[1].iov_base = "in one ";
+	iov[1].iov_len = 7;
+	iov[2].iov_base = "flush\n";
+	iov[2].iov_len = 6;
+	if(sys_writev(1, iov, 3) != 20 || sys_writev(1, iov, MAX_IOVEC + 1) != -1){
+		result = FAIL;
+	}
+	return result;
+}
+
+/* frame_alloc_test
+ * 
+ * frames come out aligned, distinct, and go back to the pool when freed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: frame_alloc_big, frame_free_big, frame_alloc_small, frame_free_small
+ * Files: frame.c
+ */
+int frame_alloc_test(){
+	TEST_HEADER;
+	uint32_t big_free = frame_free_big_count();
+	uint32_t small_free = frame_free_small_count();
+	uint32_t big_a, big_b, small_a, small_b;
+	int result = PASS;
+
+	big_a = frame_alloc_big();
+	big_b = frame_alloc_big();
+	small_a = frame_alloc_small();
+	small_b = frame_alloc_small();
+	if(big_a == FRAME_NONE || big_b == FRAME_NONE || big_a == big_b ||
+			(big_a & (BIG_FRAME_SIZE - 1)) || (big_b & (BIG_FRAME_SIZE - 1)) || big_a < FRAME_RESERVED_END){
+		result = FAIL;
+	}
+	if(small_a == FRAME_NONE || small_b == FRAME_NONE || small_a == small_b ||
+			(small_a & (FRAME_SIZE - 1)) || small_a < KERNEL_PAGE_START || small_a >= FRAME_RESERVED_END){
+		result = FAIL;
+	}
+	frame_free_big(big_a);
+	frame_free_big(big_b);
+	frame_free_small(small_a);
+	frame_free_small(small_b);
+	if(frame_free_big_count() != big_free || frame_free_small_count() != small_free){
+		result = FAIL;
+	}
+	if(frame_alloc_big() != big_a){		// lowest free frame is handed out again
+		result = FAIL;
+	}
+	frame_free_big(big_a);
+	return result;
+}
+
+#define SLAB_TEST_OBJS	100		// spans several slabs of 100 byte objects
+
+/* slab_alloc_test
+ * 
+ * objects are distinct, frames go back once a cache is empty and kmalloc rounds up
+ * Inputs: None
+ * Outputs: PASS/FAIL, prints the cache statistics
+ * Side Effects: None
+ * Coverage: slab_alloc, slab_free, kmalloc, kfree
+ * Files: slab.c
+ */
+int slab_alloc_test(){
+	TEST_HEADER;
+	static slab_cache_t test_cache = SLAB_CACHE_INIT("test-100", 100);
+	static uint8_t* objs[SLAB_TEST_OBJS];
+	uint32_t small_free = frame_free_small_count();
+	uint8_t* buf;
+	int i;
+	int result = PASS;
+
+	for(i = 0; i < SLAB_TEST_OBJS; i++){
+		objs[i] = slab_alloc(&test_cache);
+		if(objs[i] == NULL){
+			return FAIL;
+		}
+		memset(objs[i], i, 100);
+	}
+	for(i = 0; i < SLAB_TEST_OBJS; i++){
+		if(objs[i][0] != (uint8_t)i || objs[i][99] != (uint8_t)i){	// a neighbour wrote over it
+			result = FAIL;
+		}
+	}
+	slab_print_stats(&test_cache);
+	if(test_cache.active != SLAB_TEST_OBJS || test_cache.slabs != (SLAB_TEST_OBJS + test_cache.objs_per_slab - 1) / test_cache.objs_per_slab){
+		result = FAIL;
+	}
+	for(i = 0; i < SLAB_TEST_OBJS; i += 2){		// free in an order that empties slabs unevenly
+		slab_free(objs[i]);
+	}
+	for(i = 1; i < SLAB_TEST_OBJS; i += 2){
+		slab_free(objs[i]);
+	}
+	slab_print_stats(&test_cache);
+	if(test_cache.active != 0 || test_cache.slabs != 1 || frame_free_small_count() != small_free - 1){
+		result = FAIL;		// only the one spare slab is kept
+	}
+
+	buf = kmalloc(100);
+	if(buf == NULL || kmalloc(0) != NULL || kmalloc(4096) != NULL){
+		result = FAIL;
+	}
+	kfree(buf);
+	kmalloc_print_stats();
+	return result;
+}
+
 /* Checkpoint 5 tests */
 
+// ----------	Performance Tests	----------
+
+#define BENCH_BUF_SIZE 0x10000 // 64KB, larger than any file in filesys_img
+
+static uint8_t bench_buf[BENCH_BUF_SIZE];
+static uint8_t bench_ref_buf[BENCH_BUF_SIZE];
+
+/* read_data_bytewise
+ * 
+ * Reference copy of the old read_data loop, one memcpy per byte
+ * Inputs: same as read_data
+ * Outputs: number of bytes read
+ * Side Effects: buf is filled
+ * Files: tests.c
+ */
+static int32_t read_data_bytewise(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+	uint32_t inode_length = inode_start[inode].b_length;
+	uint32_t nth = offset / BLOCK_SIZE;
+	uint32_t byte = offset % BLOCK_SIZE;
+	uint32_t bytes_read = 0;
+	uint8_t* current_DB;
+
+	if(offset >= inode_length) {return 0;}
+	if(length > inode_length - offset) {length = inode_length - offset;}
+
+	current_DB = &(db_start[inode_start[inode].data_blocks[nth] * BLOCK_SIZE]);
+	while(bytes_read < length){
+		if(byte >= BLOCK_SIZE){
+			byte = 0;
+			nth++;
+			current_DB = &(db_start[inode_start[inode].data_blocks[nth] * BLOCK_SIZE]);
+		} else {
+			memcpy(buf, current_DB + byte, 1);
+			buf++;
+			byte++;
+			bytes_read++;
+		}
+	}
+	return bytes_read;
+}
+
+/* file_read_bench_test
+ * 
+ * Reads every regular file in filesys_img with the byte-wise reference loop
+ * and with read_data, checks that both agree and prints cycles per KB for each
+ * Inputs: None
+ * Outputs: PASS/FAIL if both paths return the same bytes
+ * Side Effects: Prints timing results
+ * Coverage: File System
+ * Files: file_system.c
+ */
+int file_read_bench_test(){
+	TEST_HEADER;
+	int i, j;
+	int result = PASS;
+	uint32_t total_bytes = 0;
+	uint32_t old_cycles = 0;
+	uint32_t new_cycles = 0;
+	uint32_t t0, t1;
+	int32_t old_count, new_count;
+	dentry_t dentry;
+
+	for(i = 0; i < DIR_ENTRIES; i++){
+		if(read_dentry_by_index(i, &dentry) == -1 || dentry.file_name[0] == '\0' || dentry.file_type != 2){
+			continue; // only regular files have data blocks
+		}
+
+		t0 = read_tsc();
+		old_count = read_data_bytewise(dentry.inode_number, 0, bench_ref_buf, BENCH_BUF_SIZE);
+		t1 = read_tsc();
+		old_cycles += t1 - t0;
+
+		t0 = read_tsc();
+		new_count = read_data(dentry.inode_number, 0, bench_buf, BENCH_BUF_SIZE);
+		t1 = read_tsc();
+		new_cycles += t1 - t0;
+
+		if(old_count != new_count){
+			result = FAIL;
+		}
+		for(j = 0; j < new_count && result == PASS; j++){ // both paths must copy the same bytes
+			if(bench_buf[j] != bench_ref_buf[j]){
+				printf("mismatch in %s at %d\n", dentry.file_name, j);
+				result = FAIL;
+			}
+		}
+		total_bytes += new_count;
+	}
+
+	printf("read %u bytes\n", total_bytes);
+	printf("byte-wise:  %u cycles/KB\n", old_cycles / (total_bytes / 1024 + 1));
+	printf("block-wise: %u cycles/KB\n", new_cycles / (total_bytes / 1024 + 1));
+
+	return result;
+}
+
+
+/* file_read_offsets_test
+ * 
+ * Reads every regular file from offsets on and around block boundaries through
+ * the run cache and checks each read against the byte-wise reference
+ * Inputs: None
+ * Outputs: PASS/FAIL if every read matches
+ * Side Effects: None
+ * Coverage: File System
+ * Files: file_system.c
+ */
+int file_read_offsets_test(){
+	TEST_HEADER;
+	int i, j, k;
+	int result = PASS;
+	int32_t ref_count, count;
+	uint32_t offsets[] = {0, 1, BLOCK_SIZE - 1, BLOCK_SIZE, BLOCK_SIZE + 1, 3 * BLOCK_SIZE + 17};
+	uint32_t lengths[] = {1, BLOCK_SIZE - 1, BLOCK_SIZE + 2, BENCH_BUF_SIZE};
+	dentry_t dentry;
+
+	for(i = 0; i < DIR_ENTRIES; i++){
+		if(read_dentry_by_index(i, &dentry) == -1 || dentry.file_name[0] == '\0' || dentry.file_type != 2){
+			continue;
+		}
+		for(j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++){
+			for(k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++){
+				ref_count = read_data_bytewise(dentry.inode_number, offsets[j], bench_ref_buf, lengths[k]);
+				count = read_data(dentry.inode_number, offsets[j], bench_buf, lengths[k]);
+				if(count != ref_count){
+					result = FAIL;
+				}
+				while(--count >= 0 && result == PASS){
+					if(bench_buf[count] != bench_ref_buf[count]){
+						printf("%s differs at offset %u\n", dentry.file_name, offsets[j] + count);
+						result = FAIL;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+#define LOOKUP_ROUNDS 1000 // lookups of each name per timing run
+
+/* read_dentry_linear
+ * 
+ * Reference copy of the old linear-scan lookup, strlen twice plus strncmp per entry
+ * Inputs: same as read_dentry_by_name
+ * Outputs: 0 if found, -1 if not
+ * Side Effects: dentry is filled
+ * Files: tests.c
+ */
+static int32_t read_dentry_linear(const uint8_t* fname, dentry_t* dentry){
+	int i;
+	uint32_t len = strlen((int8_t*)fname);
+
+	if(len > MAX_NAME_LENGTH || len == 0) {return -1;}
+
+	for(i = 0; i < DIR_ENTRIES; i++){
+		if(strlen((int8_t*)boot_block->dir_entries[i].file_name) > len){
+			len = strlen((int8_t*)boot_block->dir_entries[i].file_name);
+		}
+		if(len > MAX_NAME_LENGTH){
+			len = MAX_NAME_LENGTH;
+		}
+		if(strncmp((int8_t*)boot_block->dir_entries[i].file_name, (int8_t*)fname, len) == 0){
+			*dentry = boot_block->dir_entries[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* dir_lookup_bench_test
+ * 
+ * Times LOOKUP_ROUNDS lookups of every file name (plus a missing name) with the
+ * linear scan and with the hashed index, and checks that both find the same inode
+ * Inputs: None
+ * Outputs: PASS/FAIL if both lookups agree
+ * Side Effects: Prints cycles per lookup
+ * Coverage: File System
+ * Files: file_system.c
+ */
+int dir_lookup_bench_test(){
+	TEST_HEADER;
+	int i, j;
+	int result = PASS;
+	int names = 0;
+	uint32_t linear_cycles = 0;
+	uint32_t hashed_cycles = 0;
+	uint32_t t0, t1;
+	int32_t linear_res, hashed_res;
+	uint8_t name[MAX_NAME_LENGTH + 1];
+	dentry_t dentry, linear_dentry, hashed_dentry;
+
+	for(i = 0; i <= DIR_ENTRIES; i++){
+		if(i == DIR_ENTRIES){
+			strcpy((int8_t*)name, "missing.txt"); // worst case for the linear scan
+		} else if(read_dentry_by_index(i, &dentry) == -1 || dentry.file_name[0] == '\0'){
+			continue;
+		} else {
+			strncpy((int8_t*)name, (int8_t*)dentry.file_name, MAX_NAME_LENGTH);
+			name[MAX_NAME_LENGTH] = '\0';
+		}
+
+		t0 = read_tsc();
+		for(j = 0; j < LOOKUP_ROUNDS; j++){
+			linear_res = read_dentry_linear(name, &linear_dentry);
+		}
+		t1 = read_tsc();
+		linear_cycles += t1 - t0;
+
+		t0 = read_tsc();
+		for(j = 0; j < LOOKUP_ROUNDS; j++){
+			hashed_res = read_dentry_by_name(name, &hashed_dentry);
+		}
+		t1 = read_tsc();
+		hashed_cycles += t1 - t0;
+
+		if(linear_res != hashed_res || (hashed_res == 0 && linear_dentry.inode_number != hashed_dentry.inode_number)){
+			printf("lookup mismatch for %s\n", name);
+			result = FAIL;
+		}
+		names++;
+	}
+
+	printf("linear: %u cycles/lookup\n", linear_cycles / (names * LOOKUP_ROUNDS));
+	printf("hashed: %u cycles/lookup\n", hashed_cycles / (names * LOOKUP_ROUNDS));
+
+	return result;
+}
+
+
+#define TERM_BENCH_BYTES	4096
+
+/* terminal_write_bench_test
+ * 
+ * Times a 4KB terminal_write of full lines, enough to scroll the screen several times
+ * Inputs: None
+ * Outputs: PASS/FAIL if every byte is written
+ * Side Effects: Prints cycles per byte, scrolls the screen
+ * Coverage: Terminal, VGA output
+ * Files: terminal_driver.c, lib.c
+ */
+int terminal_write_bench_test(){
+	TEST_HEADER;
+	int i;
+	int32_t written;
+	uint32_t t0, t1;
+
+	for(i = 0; i < TERM_BENCH_BYTES; i++){
+		bench_buf[i] = (i % 80 == 79) ? '\n' : 'a' + (i % 26); // 79 characters and a newline per line
+	}
+
+	t0 = read_tsc();
+	written = terminal_write(&get_cur_PCB()->file_descriptor[1], bench_buf, TERM_BENCH_BYTES);
+	t1 = read_tsc();
+
+	printf("terminal_write: %u cycles/byte\n", (t1 - t0) / TERM_BENCH_BYTES);
+
+	return (written == TERM_BENCH_BYTES) ? PASS : FAIL;
+}
+
+#define SYSCALL_BENCH_CALLS	1000000
+#define SYSCALL_READ		3		// read(-1, ...) fails its first check, a null syscall
+
+/* syscall_entry_bench_test
+ * 
+ * times null read syscalls through int 0x80 and through SYSENTER
+ * Inputs: None
+ * Outputs: PASS/FAIL if every call returned -1, prints cycles per call for each path
+ * Side Effects: None
+ * Coverage: sys_call_handler, sysenter_handler
+ * Files: interrupt_linkage.S, idt.c
+ * Runs in ring 0, so int 0x80 skips the stack switch and SYSENTER comes back through
+ * sysenter_kernel_handler with a jump instead of SYSEXIT. Entry and dispatch are the same as from a program.
+ */
+int syscall_entry_bench_test(){
+	TEST_HEADER;
+	uint32_t saved_esp0 = tss.esp0;
+	uint32_t esp, flags;
+	uint32_t t0, t1, t2;
+	int32_t ret;
+	uint32_t ecx, edx;
+	int32_t bad = 0;
+	int i;
+
+	if(!sysenter_enabled){
+		printf("no SYSENTER on this cpu\n");
+		return FAIL;
+	}
+	asm volatile("movl %%esp, %0" : "=r"(esp));
+	tss.esp0 = esp - 256;		// SYSENTER's stack, well below this frame
+
+	t0 = read_tsc();
+	for(i = 0; i < SYSCALL_BENCH_CALLS; i++){
+		asm volatile("int $0x80" : "=a"(ret) : "a"(SYSCALL_READ), "b"(-1), "c"(0), "d"(0) : "memory", "cc");
+		bad |= (ret != -1);
+	}
+	cli_and_save(flags);
+	wrmsr(IA32_SYSENTER_EIP, (uint32_t)sysenter_kernel_handler);
+	t1 = read_tsc();
+	for(i = 0; i < SYSCALL_BENCH_CALLS; i++){
+		ecx = edx = 0;		// come back holding the return esp and eip
+		asm volatile("pushl %%ebp\n\t"
+					 "movl %%esp, %%ebp\n\t"
+					 "movl $1f, %%edi\n\t"
+					 "sysenter\n\t"
+					 "1: popl %%ebp"
+					 : "=a"(ret), "+c"(ecx), "+d"(edx) : "a"(SYSCALL_READ), "b"(-1) : "edi", "memory", "cc");
+		bad |= (ret != -1);
+	}
+	t2 = read_tsc();
+	wrmsr(IA32_SYSENTER_EIP, (uint32_t)sysenter_handler);
+	restore_flags(flags);
+	tss.esp0 = saved_esp0;
+
+	printf("int 0x80: %u cycles/call, sysenter: %u cycles/call\n",
+			(t1 - t0) / SYSCALL_BENCH_CALLS, (t2 - t1) / SYSCALL_BENCH_CALLS);
+	return bad ? FAIL : PASS;
+}
+
+#define PIPE_BENCH_BYTES	(64 * 1024 * 1024)
+#define PIPE_BENCH_CHUNK	(PIPE_SIZE / 2)		// a write and a read per half ring
+
+/* pipe_bench_test
+ * 
+ * moves 64MB through a pipe and times it
+ * Inputs: None
+ * Outputs: PASS/FAIL if every byte came through, prints cycles per KB
+ * Side Effects: None
+ * Coverage: pipe_read, pipe_write
+ * Files: pipe.c
+ * Tests only have the kernel's context, so one side writes half a ring and then reads it back instead of two
+ * processes blocking on each other. That times the copies and syscall dispatch, not the context switches.
+ */
+int pipe_bench_test(){
+	TEST_HEADER;
+	static uint8_t chunk[PIPE_BENCH_CHUNK];
+	int32_t fds[2];
+	uint32_t moved = 0;
+	uint32_t t0, t1;
+
+	if(sys_pipe(fds) == -1){
+		return FAIL;
+	}
+	t0 = read_tsc();
+	while(moved < PIPE_BENCH_BYTES){
+		if(sys_write(fds[1], chunk, PIPE_BENCH_CHUNK) != PIPE_BENCH_CHUNK ||
+		   sys_read(fds[0], chunk, PIPE_BENCH_CHUNK) != PIPE_BENCH_CHUNK){
+			break;
+		}
+		moved += PIPE_BENCH_CHUNK;
+	}
+	t1 = read_tsc();
+	sys_close(fds[1]);
+	sys_close(fds[0]);
+
+	printf("pipe: %u cycles/KB\n", (t1 - t0) / (PIPE_BENCH_BYTES / 1024));
+	return (moved == PIPE_BENCH_BYTES) ? PASS : FAIL;
+}
+
+#define TLB_BENCH_ROUNDS	100000
+#define TLB_BENCH_PAGES		8		// pages each fake process touches, a small program's code, data and stack
+
+static paging_table_t tlb_bench_tables[2][ENTRIES] __attribute__((aligned(4096)));
+
+/* tlb_bench_switch
+ * helper for tlb_switch_bench_test, one process switch worth of paging work: load the other
+ * process's directory, then touch its pages and what the kernel uses around it
+ */
+static uint32_t tlb_bench_switch(page_dir_t* dir){
+	volatile uint8_t* kernel_set[] = {(uint8_t*)VIDEO, (uint8_t*)TERMINAL_BACKING(0), (uint8_t*)TERMINAL_BACKING(1),
+									  (uint8_t*)TERMINAL_BACKING(2), (uint8_t*)paging_directory, (uint8_t*)&tss};
+	uint32_t sum = 0;
+	int i;
+
+	loadPagingDirectory((unsigned int*)dir);
+	for(i = 0; i < TLB_BENCH_PAGES; i++){
+		sum += *(volatile uint8_t*)(PROGRAM_IMG + i * PAGE_SIZE);
+	}
+	for(i = 0; i < sizeof(kernel_set) / sizeof(kernel_set[0]); i++){
+		sum += *kernel_set[i];
+	}
+	return sum;
+}
+
+/* tlb_switch_bench_test
+ * 
+ * times switching between two process directories with CR4.PGE on and off
+ * Inputs: None
+ * Outputs: PASS/FAIL if both runs read the same bytes, prints cycles per switch pair for each
+ * Side Effects: None, CR4.PGE and the directory that was loaded are put back
+ * Coverage: page_dir_create, loadPagingDirectory, enable_global_pages
+ * Files: paging.c
+ * Tests can't execute programs from the kernel's context, so two directories from page_dir_create
+ * stand in for a parent and a child and the loop does what execute/halt and the scheduler do to switch them.
+ */
+int tlb_switch_bench_test(){
+	TEST_HEADER;
+	page_dir_t* dirs[2];
+	uint32_t saved_cr3, cr4;
+	uint32_t frames[TLB_BENCH_PAGES];
+	uint32_t sums[2] = {0, 0};
+	uint32_t cycles[2] = {0, 0};
+	uint32_t t0;
+	int i, global;
+	int result = PASS;
+
+	dirs[0] = page_dir_create();
+	dirs[1] = page_dir_create();
+	for(i = 0; i < TLB_BENCH_PAGES; i++){
+		frames[i] = frame_alloc_small();
+		if(frames[i] == FRAME_NONE){
+			result = FAIL;
+		}
+	}
+	if(dirs[0] == NULL || dirs[1] == NULL){
+		result = FAIL;
+	}
+	asm volatile("movl %%cr3, %0" : "=r"(saved_cr3));
+	asm volatile("movl %%cr4, %0" : "=r"(cr4));
+
+	if(result == PASS){
+		memset(tlb_bench_tables, 0, sizeof(tlb_bench_tables));
+		for(i = 0; i < TLB_BENCH_PAGES; i++){		// both processes see the same frames, only the mappings differ
+			map_page(tlb_bench_tables[0], PROGRAM_IMG + i * PAGE_SIZE, frames[i], 0);
+			map_page(tlb_bench_tables[1], PROGRAM_IMG + i * PAGE_SIZE, frames[i], 0);
+		}
+		map_table(dirs[0], USER_SPACE, tlb_bench_tables[0]);
+		map_table(dirs[1], USER_SPACE, tlb_bench_tables[1]);
+		for(global = 0; global <= global_pages_enabled; global++){
+			// writing PGE flushes the whole TLB, global entries too
+			asm volatile("movl %0, %%cr4" : : "r"(global ? (cr4 | CR4_PGE) : (cr4 & ~CR4_PGE)) : "memory");
+			t0 = read_tsc();
+			for(i = 0; i < TLB_BENCH_ROUNDS; i++){
+				sums[global] += tlb_bench_switch(dirs[1]);		// execute
+				sums[global] += tlb_bench_switch(dirs[0]);		// halt
+			}
+			cycles[global] = (read_tsc() - t0) / TLB_BENCH_ROUNDS;
+		}
+		asm volatile("movl %0, %%cr4" : : "r"(cr4) : "memory");
+		if(global_pages_enabled){
+			printf("process switch pair: %u cycles without PGE, %u cycles with PGE\n", cycles[0], cycles[1]);
+			if(sums[0] != sums[1]){
+				result = FAIL;
+			}
+		}else{
+			printf("process switch pair: %u cycles, no PGE on this cpu\n", cycles[0]);
+		}
+	}
+
+	loadPagingDirectory((unsigned int*)saved_cr3);
+	for(i = 0; i < 2; i++){
+		if(dirs[i] != NULL){
+			page_dir_free(dirs[i]);
+		}
+	}
+	for(i = 0; i < TLB_BENCH_PAGES; i++){
+		if(frames[i] != FRAME_NONE){
+			frame_free_small(frames[i]);
+		}
+	}
+	return result;
+}
 
 /* Test suite entry point */
 void launch_tests(){
@@ -730,8 +1609,28 @@ void launch_tests(){
 
 	//----------	RTC		-------
 	//TEST_OUTPUT("rtc_frequency_cycle_test", rtc_frequency_cycle_test());
+	//TEST_OUTPUT("rtc_per_fd_rate_test", rtc_per_fd_rate_test());
 
 	//TEST_OUTPUT("terminal_driver_test", terminal_driver_test());
+
+	// Checkpoint 4
+	//TEST_OUTPUT("kernel_large_page_test", kernel_large_page_test());
+	//TEST_OUTPUT("page_dir_test", page_dir_test());
+	//TEST_OUTPUT("global_pages_test", global_pages_test());
+	//TEST_OUTPUT("frame_alloc_test", frame_alloc_test());
+	//TEST_OUTPUT("slab_alloc_test", slab_alloc_test());
+	//TEST_OUTPUT("readv_writev_test", readv_writev_test());
+	//TEST_OUTPUT("mmap_test", mmap_test());
+	//TEST_OUTPUT("pipe_test", pipe_test());
+
+	//----------	Performance		-------
+	//TEST_OUTPUT("file_read_bench_test", file_read_bench_test());
+	//TEST_OUTPUT("file_read_offsets_test", file_read_offsets_test());
+	//TEST_OUTPUT("dir_lookup_bench_test", dir_lookup_bench_test());
+	//TEST_OUTPUT("terminal_write_bench_test", terminal_write_bench_test());
+	//TEST_OUTPUT("syscall_entry_bench_test", syscall_entry_bench_test());
+	//TEST_OUTPUT("pipe_bench_test", pipe_bench_test());
+	//TEST_OUTPUT("tlb_switch_bench_test", tlb_switch_bench_test());
 }
 
 